@@ -204,6 +204,7 @@ static void block_account_one_io(BlockAcctStats *stats, BlockAcctCookie *cookie,
                                  bool failed)
 {
     BlockAcctTimedStats *s;
+    BlockLatencyHistogram *hist;
     int64_t time_ns = qemu_clock_get_ns(clock_type);
     int64_t latency_ns = time_ns - cookie->start_time_ns;
 
@@ -217,23 +218,33 @@ static void block_account_one_io(BlockAcctStats *stats, BlockAcctCookie *cookie,
         return;
     }
 
-    WITH_QEMU_LOCK_GUARD(&stats->lock) {
-        if (failed) {
-            stats->failed_ops[cookie->type]++;
-        } else {
-            stats->nr_bytes[cookie->type] += cookie->bytes;
-            stats->nr_ops[cookie->type]++;
-        }
-
-        block_latency_histogram_account(&stats->latency_histogram[cookie->type],
-                                        latency_ns);
+    if (failed) {
+        stat64_add(&stats->failed_ops[cookie->type], 1);
+    } else {
+        stat64_add(&stats->nr_bytes[cookie->type], cookie->bytes);
+        stat64_add(&stats->nr_ops[cookie->type], 1);
+    }
 
-        if (!failed || stats->account_failed) {
-            stats->total_time_ns[cookie->type] += latency_ns;
-            stats->last_access_time_ns = time_ns;
+    if (!failed || stats->account_failed) {
+        stat64_add(&stats->total_time_ns[cookie->type], latency_ns);
+        stat64_max(&stats->last_access_time_ns, time_ns);
+    }
 
-            QSLIST_FOREACH(s, &stats->intervals, entries) {
-                timed_average_account(&s->latency[cookie->type], latency_ns);
+    /*
+     * Latency histograms and timed intervals are opt-in.  Only take the
+     * lock when one of them is enabled, so that requests completing in
+     * different iothreads do not serialize on it by default.
+     */
+    hist = &stats->latency_histogram[cookie->type];
+    if (qatomic_read(&hist->bins) || !QSLIST_EMPTY(&stats->intervals)) {
+        WITH_QEMU_LOCK_GUARD(&stats->lock) {
+            block_latency_histogram_account(hist, latency_ns);
+
+            if (!failed || stats->account_failed) {
+                QSLIST_FOREACH(s, &stats->intervals, entries) {
+                    timed_average_account(&s->latency[cookie->type],
+                                          latency_ns);
+                }
             }
         }
     }
@@ -259,13 +270,11 @@ void block_acct_invalid(BlockAcctStats *stats, enum BlockAcctType type)
      * not.  The reason is that invalid requests are accounted during their
      * submission, therefore there's no actual I/O involved.
      */
-    qemu_mutex_lock(&stats->lock);
-    stats->invalid_ops[type]++;
+    stat64_add(&stats->invalid_ops[type], 1);
 
     if (stats->account_invalid) {
-        stats->last_access_time_ns = qemu_clock_get_ns(clock_type);
+        stat64_max(&stats->last_access_time_ns, qemu_clock_get_ns(clock_type));
     }
-    qemu_mutex_unlock(&stats->lock);
 }
 
 void block_acct_merge_done(BlockAcctStats *stats, enum BlockAcctType type,
@@ -273,14 +282,13 @@ void block_acct_merge_done(BlockAcctStats *stats, enum BlockAcctType type,
 {
     assert(type < BLOCK_MAX_IOTYPE);
 
-    qemu_mutex_lock(&stats->lock);
-    stats->merged[type] += num_requests;
-    qemu_mutex_unlock(&stats->lock);
+    stat64_add(&stats->merged[type], num_requests);
 }
 
 int64_t block_acct_idle_time_ns(BlockAcctStats *stats)
 {
-    return qemu_clock_get_ns(clock_type) - stats->last_access_time_ns;
+    return qemu_clock_get_ns(clock_type) -
+        stat64_get(&stats->last_access_time_ns);
 }
 
 double block_acct_queue_depth(BlockAcctTimedStats *stats,
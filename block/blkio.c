@@ -641,43 +641,8 @@ static int blkio_io_uring_connect(BlockDriverState *bs, QDict *options,
     return 0;
 }
 
-static int blkio_nvme_io_uring_connect(BlockDriverState *bs, QDict *options,
-                                       int flags, Error **errp)
-{
-    const char *path = qdict_get_try_str(options, "path");
-    BDRVBlkioState *s = bs->opaque;
-    int ret;
-
-    if (!path) {
-        error_setg(errp, "missing 'path' option");
-        return -EINVAL;
-    }
-
-    ret = blkio_set_str(s->blkio, "path", path);
-    qdict_del(options, "path");
-    if (ret < 0) {
-        error_setg_errno(errp, -ret, "failed to set path: %s",
-                         blkio_get_error_msg());
-        return ret;
-    }
-
-    if (!(flags & BDRV_O_NOCACHE)) {
-        error_setg(errp, "cache.direct=off is not supported");
-        return -EINVAL;
-    }
-
-    ret = blkio_connect(s->blkio);
-    if (ret < 0) {
-        error_setg_errno(errp, -ret, "blkio_connect failed: %s",
-                         blkio_get_error_msg());
-        return ret;
-    }
-
-    return 0;
-}
-
-static int blkio_virtio_blk_connect(BlockDriverState *bs, QDict *options,
-                                    int flags, Error **errp)
+static int blkio_path_connect(BlockDriverState *bs, QDict *options,
+                              int flags, Error **errp)
 {
     const char *path = qdict_get_try_str(options, "path");
     BDRVBlkioState *s = bs->opaque;
@@ -706,7 +671,8 @@ static int blkio_virtio_blk_connect(BlockDriverState *bs, QDict *options,
     if (fd_supported) {
         /*
          * `path` can contain the path of a character device
-         * (e.g. /dev/vhost-vdpa-0 or /dev/vfio/vfio) or a unix socket.
+         * (e.g. /dev/ng0n1, /dev/vhost-vdpa-0 or /dev/vfio/vfio) or a unix
+         * socket.
          *
          * So, we should always open it with O_RDWR flag, also if BDRV_O_RDWR
          * is not set in the open flags, because the exchange of IOCTL commands
@@ -818,13 +784,13 @@ static int blkio_file_open(BlockDriverState *bs, QDict *options, int flags,
     if (strcmp(blkio_driver, "io_uring") == 0) {
         ret = blkio_io_uring_connect(bs, options, flags, errp);
     } else if (strcmp(blkio_driver, "nvme-io_uring") == 0) {
-        ret = blkio_nvme_io_uring_connect(bs, options, flags, errp);
+        ret = blkio_path_connect(bs, options, flags, errp);
     } else if (strcmp(blkio_driver, "virtio-blk-vfio-pci") == 0) {
-        ret = blkio_virtio_blk_connect(bs, options, flags, errp);
+        ret = blkio_path_connect(bs, options, flags, errp);
     } else if (strcmp(blkio_driver, "virtio-blk-vhost-user") == 0) {
-        ret = blkio_virtio_blk_connect(bs, options, flags, errp);
+        ret = blkio_path_connect(bs, options, flags, errp);
     } else if (strcmp(blkio_driver, "virtio-blk-vhost-vdpa") == 0) {
-        ret = blkio_virtio_blk_connect(bs, options, flags, errp);
+        ret = blkio_path_connect(bs, options, flags, errp);
     } else {
         g_assert_not_reached();
     }
@@ -31,6 +31,9 @@
 
 #define BLOCK_COPY_MAX_COPY_RANGE (16 * MiB)
 #define BLOCK_COPY_MAX_BUFFER (1 * MiB)
+#define BLOCK_COPY_MIN_ADAPTIVE_BUFFER (256 * KiB)
+#define BLOCK_COPY_MAX_ADAPTIVE_BUFFER (8 * MiB)
+#define BLOCK_COPY_ADAPT_TASKS 16
 #define BLOCK_COPY_MAX_MEM (128 * MiB)
 #define BLOCK_COPY_MAX_WORKERS 64
 #define BLOCK_COPY_SLICE_TIME 100000000ULL /* ns */
@@ -137,6 +140,17 @@ typedef struct BlockCopyState {
     CoMutex lock;
     int64_t in_flight_bytes;
     BlockCopyMethod method;
+    /*
+     * Chunk size for COPY_READ_WRITE, tuned by
+     * block_copy_adapt_buffer_size_locked() from the throughput of the last
+     * BLOCK_COPY_ADAPT_TASKS full-sized tasks.
+     */
+    int64_t buffer_size;
+    int adapt_tasks;
+    int adapt_step; /* 1 if buffer_size is growing, -1 if shrinking */
+    int64_t adapt_bytes;
+    int64_t adapt_ns;
+    uint64_t adapt_prev_bw; /* bytes per second of the previous window */
     BlockReqList reqs;
     QLIST_HEAD(, BlockCopyCallState) calls;
     /*
@@ -168,6 +182,7 @@ static int64_t block_copy_chunk_size(BlockCopyState *s)
     case COPY_READ_WRITE_CLUSTER:
         return s->cluster_size;
     case COPY_READ_WRITE:
+        return MIN(MAX(s->cluster_size, s->buffer_size), s->max_transfer);
     case COPY_RANGE_SMALL:
         return MIN(MAX(s->cluster_size, BLOCK_COPY_MAX_BUFFER),
                    s->max_transfer);
@@ -180,6 +195,69 @@ static int64_t block_copy_chunk_size(BlockCopyState *s)
     }
 }
 
+/*
+ * Called with lock held after a COPY_READ_WRITE task of @bytes completed
+ * successfully in @ns nanoseconds.
+ *
+ * Larger chunks amortize per-request overhead, smaller chunks keep guest
+ * requests that wait for a copy-before-write operation short. Climb towards
+ * the chunk size with the best per-request throughput: keep going in the
+ * same direction while it improves noticeably, turn around when it gets
+ * worse and prefer smaller chunks when it makes no difference.
+ */
+static void block_copy_adapt_buffer_size_locked(BlockCopyState *s,
+                                                int64_t bytes, int64_t ns)
+{
+    int64_t new_size;
+    uint64_t bw;
+
+    /* Partial chunks do not tell us anything about the current size */
+    if (bytes != block_copy_chunk_size(s)) {
+        return;
+    }
+
+    s->adapt_bytes += bytes;
+    s->adapt_ns += ns;
+    if (++s->adapt_tasks < BLOCK_COPY_ADAPT_TASKS) {
+        return;
+    }
+
+    bw = s->adapt_bytes * NANOSECONDS_PER_SECOND / MAX(s->adapt_ns, 1);
+    if (s->adapt_prev_bw) {
+        if (bw < s->adapt_prev_bw - s->adapt_prev_bw / 8) {
+            s->adapt_step = -s->adapt_step;
+        } else if (bw <= s->adapt_prev_bw + s->adapt_prev_bw / 8) {
+            s->adapt_step = -1;
+        }
+    }
+
+    new_size = s->adapt_step > 0 ? s->buffer_size * 2 : s->buffer_size / 2;
+    new_size = MIN(MAX(new_size, BLOCK_COPY_MIN_ADAPTIVE_BUFFER),
+                   BLOCK_COPY_MAX_ADAPTIVE_BUFFER);
+    if (new_size == s->buffer_size ||
+        MIN(MAX(s->cluster_size, new_size), s->max_transfer) ==
+        block_copy_chunk_size(s)) {
+        /* Hit a limit, try the other direction next time */
+        s->adapt_step = -s->adapt_step;
+    } else {
+        trace_block_copy_adapt_buffer_size(s, new_size, bw);
+        s->buffer_size = new_size;
+    }
+
+    s->adapt_prev_bw = bw;
+    s->adapt_tasks = 0;
+    s->adapt_bytes = 0;
+    s->adapt_ns = 0;
+}
+
+int64_t coroutine_fn block_copy_adapt_buffer_size(BlockCopyState *s,
+                                                  int64_t bytes, int64_t ns)
+{
+    QEMU_LOCK_GUARD(&s->lock);
+    block_copy_adapt_buffer_size_locked(s, bytes, ns);
+    return block_copy_chunk_size(s);
+}
+
 /*
  * Search for the first dirty area in offset/bytes range and create task at
  * the beginning of it.
@@ -412,6 +490,8 @@ BlockCopyState *block_copy_state_new(BdrvChild *source, BdrvChild *target,
         .len = bdrv_dirty_bitmap_size(copy_bitmap),
         .write_flags = (is_fleecing ? BDRV_REQ_SERIALISING : 0),
         .mem = shres_create(BLOCK_COPY_MAX_MEM),
+        .buffer_size = BLOCK_COPY_MAX_BUFFER,
+        .adapt_step = 1,
         .max_transfer = QEMU_ALIGN_DOWN(
                                     block_copy_max_transfer(source, target),
                                     cluster_size),
@@ -564,11 +644,16 @@ static coroutine_fn int block_copy_task_entry(AioTask *task)
     BlockCopyState *s = t->s;
     bool error_is_read = false;
     BlockCopyMethod method = t->method;
+    int64_t copy_ns;
     int ret;
 
     WITH_GRAPH_RDLOCK_GUARD() {
+        /* Only time the copy itself, not waiting for the graph lock */
+        int64_t start_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+
         ret = block_copy_do_copy(s, t->req.offset, t->req.bytes, &method,
                                  &error_is_read);
+        copy_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - start_ns;
     }
 
     WITH_QEMU_LOCK_GUARD(&s->lock) {
@@ -576,6 +661,11 @@ static coroutine_fn int block_copy_task_entry(AioTask *task)
             s->method = method;
         }
 
+        if (ret >= 0 && t->method == COPY_READ_WRITE &&
+            s->method == COPY_READ_WRITE) {
+            block_copy_adapt_buffer_size_locked(s, t->req.bytes, copy_ns);
+        }
+
         if (ret < 0) {
             if (!t->call_state->ret) {
                 t->call_state->ret = ret;
@@ -32,14 +32,34 @@
 #include "qemu/option.h"
 #include "qemu/cutils.h"
 #include "qemu/memalign.h"
+#include "block/thread-pool.h"
 #include "crypto.h"
 
+/*
+ * Chunks smaller than this are encrypted or decrypted in the calling thread,
+ * where the cipher is faster than a round trip through the thread pool.
+ */
+#define BLOCK_CRYPTO_THREAD_MIN_BYTES (64 * 1024)
+
 typedef struct BlockCrypto BlockCrypto;
 
 struct BlockCrypto {
     QCryptoBlock *block;
     bool updating_keys;
     BdrvChild *header;  /* Reference to the detached LUKS header */
+
+    /*
+     * @block has one cipher per concurrent user: @n_ciphers for chunks that
+     * are processed in the thread pool, and as many again for small chunks
+     * that are processed in the calling thread.  Thread pool users wait in
+     * @cipher_queue while all of theirs are busy; inline users are only
+     * counted, atomically, in @n_inline_ciphers.
+     */
+    CoMutex lock;
+    CoQueue cipher_queue;
+    int n_ciphers;
+    int n_busy_ciphers;
+    int n_inline_ciphers;
 };
 
 
@@ -359,11 +379,14 @@ static int block_crypto_open_generic(QCryptoBlockFormat format,
     if (crypto->header != NULL) {
         cflags |= QCRYPTO_BLOCK_OPEN_DETACHED;
     }
+    crypto->n_ciphers = thread_pool_max_cpu_jobs();
+    qemu_co_mutex_init(&crypto->lock);
+    qemu_co_queue_init(&crypto->cipher_queue);
     crypto->block = qcrypto_block_open(open_opts, NULL,
                                        block_crypto_read_func,
                                        bs,
                                        cflags,
-                                       1,
+                                       2 * crypto->n_ciphers,
                                        errp);
 
     if (!crypto->block) {
@@ -467,6 +490,71 @@ static int block_crypto_reopen_prepare(BDRVReopenState *state,
  */
 #define BLOCK_CRYPTO_MAX_IO_SIZE (1024 * 1024)
 
+/* Common prototype of qcrypto_block_encrypt() and qcrypto_block_decrypt() */
+typedef int (*BlockCryptoEncDecFunc)(QCryptoBlock *block, uint64_t offset,
+                                     uint8_t *buf, size_t len, Error **errp);
+
+typedef struct BlockCryptoEncDecData {
+    QCryptoBlock *block;
+    uint64_t offset;
+    uint8_t *buf;
+    size_t len;
+
+    BlockCryptoEncDecFunc func;
+} BlockCryptoEncDecData;
+
+static int block_crypto_encdec_pool_func(void *opaque)
+{
+    BlockCryptoEncDecData *data = opaque;
+
+    return data->func(data->block, data->offset, data->buf, data->len, NULL);
+}
+
+/*
+ * Encrypt or decrypt @buf in place.  Large chunks are processed in the thread
+ * pool so that several requests can use several host CPUs.  Small chunks take
+ * no lock; they only go through the thread pool as well if more threads than
+ * there are inline ciphers process small chunks at once.
+ */
+static int coroutine_fn
+block_crypto_co_encdec(BlockCrypto *crypto, uint64_t offset, uint8_t *buf,
+                       size_t len, BlockCryptoEncDecFunc func)
+{
+    BlockCryptoEncDecData arg = {
+        .block = crypto->block,
+        .offset = offset,
+        .buf = buf,
+        .len = len,
+        .func = func,
+    };
+    int ret;
+
+    if (len < BLOCK_CRYPTO_THREAD_MIN_BYTES) {
+        if (qatomic_fetch_inc(&crypto->n_inline_ciphers) < crypto->n_ciphers) {
+            ret = block_crypto_encdec_pool_func(&arg);
+            qatomic_dec(&crypto->n_inline_ciphers);
+            return ret;
+        }
+        qatomic_dec(&crypto->n_inline_ciphers);
+    }
+
+    qemu_co_mutex_lock(&crypto->lock);
+    while (crypto->n_busy_ciphers >= crypto->n_ciphers) {
+        qemu_co_queue_wait(&crypto->cipher_queue, &crypto->lock);
+    }
+    crypto->n_busy_ciphers++;
+    qemu_co_mutex_unlock(&crypto->lock);
+
+    ret = thread_pool_submit_co(block_crypto_encdec_pool_func, &arg);
+
+    qemu_co_mutex_lock(&crypto->lock);
+    crypto->n_busy_ciphers--;
+    qemu_co_queue_next(&crypto->cipher_queue);
+    qemu_co_mutex_unlock(&crypto->lock);
+
+    return ret;
+}
+
 static int coroutine_fn GRAPH_RDLOCK
 block_crypto_co_preadv(BlockDriverState *bs, int64_t offset, int64_t bytes,
                        QEMUIOVector *qiov, BdrvRequestFlags flags)
@@ -509,8 +597,8 @@ block_crypto_co_preadv(BlockDriverState *bs, int64_t offset, int64_t bytes,
             goto cleanup;
         }
 
-        if (qcrypto_block_decrypt(crypto->block, offset + bytes_done,
-                                  cipher_data, cur_bytes, NULL) < 0) {
+        if (block_crypto_co_encdec(crypto, offset + bytes_done, cipher_data,
+                                   cur_bytes, qcrypto_block_decrypt) < 0) {
             ret = -EIO;
             goto cleanup;
         }
@@ -566,8 +654,8 @@ block_crypto_co_pwritev(BlockDriverState *bs, int64_t offset, int64_t bytes,
 
         qemu_iovec_to_buf(qiov, bytes_done, cipher_data, cur_bytes);
 
-        if (qcrypto_block_encrypt(crypto->block, offset + bytes_done,
-                                  cipher_data, cur_bytes, NULL) < 0) {
+        if (block_crypto_co_encdec(crypto, offset + bytes_done, cipher_data,
+                                   cur_bytes, qcrypto_block_encrypt) < 0) {
             ret = -EIO;
             goto cleanup;
         }
@@ -18,6 +18,7 @@
 #include "vhost-user-blk-server.h"
 #include "qapi/error.h"
 #include "qom/object_interfaces.h"
+#include "sysemu/iothread.h"
 #include "util/block-helpers.h"
 #include "virtio-blk-handler.h"
 
@@ -38,6 +39,11 @@ typedef struct {
     VirtioBlkHandler handler;
     QIOChannelSocket *sioc;
     struct virtio_blk_config blkcfg;
+
+    /* IOThreads that virtqueues are distributed across, may be empty */
+    IOThread **iothreads;
+    AioContext **vq_ctxs;
+    unsigned int nr_iothreads;
 } VuBlkExport;
 
 static void vu_blk_req_complete(VuBlkReq *req, size_t in_len)
@@ -307,6 +313,42 @@ static bool vu_blk_drained_poll(void *opaque)
     return server->co_trip || vhost_user_server_has_in_flight(server);
 }
 
+static void vu_blk_exp_put_iothreads(VuBlkExport *vexp)
+{
+    unsigned int i;
+
+    for (i = 0; i < vexp->nr_iothreads && vexp->iothreads[i]; i++) {
+        object_unref(OBJECT(vexp->iothreads[i]));
+    }
+    g_free(vexp->iothreads);
+    g_free(vexp->vq_ctxs);
+}
+
+static bool vu_blk_exp_get_iothreads(VuBlkExport *vexp, strList *iothreads,
+                                     Error **errp)
+{
+    strList *node;
+    unsigned int i;
+
+    for (node = iothreads; node; node = node->next) {
+        vexp->nr_iothreads++;
+    }
+    vexp->iothreads = g_new0(IOThread *, vexp->nr_iothreads);
+    vexp->vq_ctxs = g_new0(AioContext *, vexp->nr_iothreads);
+
+    for (i = 0, node = iothreads; node; i++, node = node->next) {
+        vexp->iothreads[i] = iothread_by_id(node->value);
+        if (!vexp->iothreads[i]) {
+            error_setg(errp, "iothread \"%s\" not found", node->value);
+            vu_blk_exp_put_iothreads(vexp);
+            return false;
+        }
+        object_ref(OBJECT(vexp->iothreads[i]));
+        vexp->vq_ctxs[i] = iothread_get_aio_context(vexp->iothreads[i]);
+    }
+    return true;
+}
+
 static const BlockDevOps vu_blk_dev_ops = {
     .drained_begin = vu_blk_drained_begin,
     .drained_end   = vu_blk_drained_end,
@@ -344,6 +386,9 @@ static int vu_blk_exp_create(BlockExport *exp, BlockExportOptions *opts,
         error_setg(errp, "num-queues must be greater than 0");
         return -EINVAL;
     }
+    if (!vu_blk_exp_get_iothreads(vexp, vu_opts->iothreads, errp)) {
+        return -ENOENT;
+    }
     vexp->handler.blk = exp->blk;
     vexp->handler.serial = g_strdup("vhost_user_blk");
     vexp->handler.logical_block_size = logical_block_size;
@@ -358,10 +403,12 @@ static int vu_blk_exp_create(BlockExport *exp, BlockExportOptions *opts,
     blk_set_dev_ops(exp->blk, &vu_blk_dev_ops, vexp);
 
     if (!vhost_user_server_start(&vexp->vu_server, vu_opts->addr, exp->ctx,
-                                 num_queues, &vu_blk_iface, errp)) {
+                                 num_queues, vexp->vq_ctxs, vexp->nr_iothreads,
+                                 &vu_blk_iface, errp)) {
         blk_remove_aio_context_notifier(exp->blk, blk_aio_attached,
                                         blk_aio_detach, vexp);
         g_free(vexp->handler.serial);
+        vu_blk_exp_put_iothreads(vexp);
         return -EADDRNOTAVAIL;
     }
 
@@ -375,6 +422,7 @@ static void vu_blk_exp_delete(BlockExport *exp)
     blk_remove_aio_context_notifier(exp->blk, blk_aio_attached, blk_aio_detach,
                                     vexp);
     g_free(vexp->handler.serial);
+    vu_blk_exp_put_iothreads(vexp);
 }
 
 const BlockExportDriver blk_exp_vhost_user_blk = {
@@ -38,6 +38,7 @@
 #include "block/raw-aio.h"
 #include "qapi/qmp/qdict.h"
 #include "qapi/qmp/qstring.h"
+#include "exec/memory.h" /* for ram_block_discard_disable() */
 
 #include "scsi/pr-manager.h"
 #include "scsi/constants.h"
@@ -160,6 +161,7 @@ typedef struct BDRVRawState {
     bool has_write_zeroes:1;
     bool use_linux_aio:1;
     bool use_linux_io_uring:1;
+    bool use_fixed_buffers:1;
     int page_cache_inconsistent; /* errno from fdatasync failure */
     bool has_fallocate;
     bool needs_alignment;
@@ -173,6 +175,9 @@ typedef struct BDRVRawState {
     } stats;
 
     PRManager *pr_mgr;
+
+    /* struct iovec of each buffer registered as io_uring fixed buffer */
+    GArray *fixed_bufs;
 } BDRVRawState;
 
 typedef struct BDRVRawReopenState {
@@ -560,6 +565,13 @@ static QemuOptsList raw_runtime_opts = {
             .type = QEMU_OPT_NUMBER,
             .help = "AIO max batch size (0 = auto handled by AIO backend, default: 0)",
         },
+#ifdef CONFIG_LINUX_IO_URING
+        {
+            .name = "aio-fixed-buffers",
+            .type = QEMU_OPT_BOOL,
+            .help = "register guest RAM as io_uring fixed buffers (default: off)",
+        },
+#endif
         {
             .name = "locking",
             .type = QEMU_OPT_STRING,
@@ -637,6 +649,12 @@ static int raw_open_common(BlockDriverState *bs, QDict *options,
     s->use_linux_aio = (aio == BLOCKDEV_AIO_OPTIONS_NATIVE);
 #ifdef CONFIG_LINUX_IO_URING
     s->use_linux_io_uring = (aio == BLOCKDEV_AIO_OPTIONS_IO_URING);
+    s->use_fixed_buffers = qemu_opt_get_bool(opts, "aio-fixed-buffers", false);
+    if (s->use_fixed_buffers && !s->use_linux_io_uring) {
+        error_setg(errp, "aio-fixed-buffers requires aio=io_uring");
+        ret = -EINVAL;
+        goto fail;
+    }
 #endif
 
     s->aio_max_batch = qemu_opt_get_number(opts, "aio-max-batch", 0);
@@ -805,6 +823,25 @@ static int raw_open_common(BlockDriverState *bs, QDict *options,
         /* When extending regular files, we get zeros from the OS */
         bs->supported_truncate_flags = BDRV_REQ_ZERO_WRITE;
     }
+
+#ifdef CONFIG_LINUX_IO_URING
+    if (s->use_fixed_buffers) {
+        /*
+         * Fixed buffers pin guest RAM, so memory that the guest discards
+         * would no longer be the memory that requests access.
+         */
+        ret = ram_block_discard_disable(true);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "ram_block_discard_disable() failed");
+            goto fail;
+        }
+        s->fixed_bufs = g_array_new(false, false, sizeof(struct iovec));
+    }
+    if (s->use_linux_io_uring) {
+        luring_register_fd(s->fd);
+    }
+#endif
+
     ret = 0;
 fail:
     if (ret < 0 && s->fd != -1) {
@@ -2607,15 +2644,79 @@ static void raw_close(BlockDriverState *bs)
 {
     BDRVRawState *s = bs->opaque;
 
+#ifdef CONFIG_LINUX_IO_URING
+    if (s->fixed_bufs) {
+        struct iovec *iov;
+        guint i;
+
+        for (i = 0; i < s->fixed_bufs->len; i++) {
+            iov = &g_array_index(s->fixed_bufs, struct iovec, i);
+            luring_unregister_buf(iov->iov_base, iov->iov_len);
+        }
+        g_array_free(s->fixed_bufs, true);
+        s->fixed_bufs = NULL;
+        ram_block_discard_disable(false);
+    }
+#endif
+
     if (s->fd >= 0) {
 #if defined(CONFIG_BLKZONED)
         g_free(bs->wps);
+#endif
+#ifdef CONFIG_LINUX_IO_URING
+        luring_unregister_fd(s->fd);
 #endif
         qemu_close(s->fd);
         s->fd = -1;
     }
 }
 
+#ifdef CONFIG_LINUX_IO_URING
+static bool raw_register_buf(BlockDriverState *bs, void *host, size_t size,
+                             Error **errp)
+{
+    BDRVRawState *s = bs->opaque;
+    struct iovec iov = {
+        .iov_base = host,
+        .iov_len = size,
+    };
+
+    if (!s->fixed_bufs) {
+        return true;
+    }
+
+    if (!luring_register_buf(host, size, errp)) {
+        return false;
+    }
+    g_array_append_val(s->fixed_bufs, iov);
+    return true;
+}
+
+static void raw_unregister_buf(BlockDriverState *bs, void *host, size_t size)
+{
+    BDRVRawState *s = bs->opaque;
+    struct iovec *iov;
+    guint i;
+
+    if (!s->fixed_bufs) {
+        return;
+    }
+
+    /*
+     * Only drop what this node registered; the graph may have changed since
+     * bdrv_register_buf() was called.
+     */
+    for (i = 0; i < s->fixed_bufs->len; i++) {
+        iov = &g_array_index(s->fixed_bufs, struct iovec, i);
+        if (iov->iov_base == host && iov->iov_len == size) {
+            luring_unregister_buf(host, size);
+            g_array_remove_index_fast(s->fixed_bufs, i);
+            return;
+        }
+    }
+}
+#endif
+
 /**
  * Truncates the given regular file @fd to @offset and, when growing, fills the
  * new space according to @prealloc.
@@ -3802,9 +3903,17 @@ static void raw_set_perm(BlockDriverState *bs, uint64_t perm, uint64_t shared)
     /* For reopen, we have already switched to the new fd (.bdrv_set_perm is
      * called after .bdrv_reopen_commit) */
     if (s->perm_change_fd && s->fd != s->perm_change_fd) {
+#ifdef CONFIG_LINUX_IO_URING
+        luring_unregister_fd(s->fd);
+#endif
         qemu_close(s->fd);
         s->fd = s->perm_change_fd;
         s->open_flags = s->perm_change_flags;
+#ifdef CONFIG_LINUX_IO_URING
+        if (s->use_linux_io_uring) {
+            luring_register_fd(s->fd);
+        }
+#endif
     }
     s->perm_change_fd = 0;
 
@@ -3909,6 +4018,10 @@ BlockDriver bdrv_file = {
     .bdrv_check_perm = raw_check_perm,
     .bdrv_set_perm   = raw_set_perm,
     .bdrv_abort_perm_update = raw_abort_perm_update,
+#ifdef CONFIG_LINUX_IO_URING
+    .bdrv_register_buf = raw_register_buf,
+    .bdrv_unregister_buf = raw_unregister_buf,
+#endif
     .create_opts = &raw_create_opts,
     .mutable_opts = mutable_opts,
 };
@@ -4278,6 +4391,10 @@ static BlockDriver bdrv_host_device = {
     .bdrv_check_perm = raw_check_perm,
     .bdrv_set_perm   = raw_set_perm,
     .bdrv_abort_perm_update = raw_abort_perm_update,
+#ifdef CONFIG_LINUX_IO_URING
+    .bdrv_register_buf = raw_register_buf,
+    .bdrv_unregister_buf = raw_unregister_buf,
+#endif
     .bdrv_probe_blocksizes = hdev_probe_blocksizes,
     .bdrv_probe_geometry = hdev_probe_geometry,
 
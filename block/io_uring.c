@@ -11,7 +11,12 @@
 #include "qemu/osdep.h"
 #include <liburing.h>
 #include "block/aio.h"
+#include "qemu/bitmap.h"
+#include "qemu/error-report.h"
+#include "qemu/lockable.h"
 #include "qemu/queue.h"
+#include "qemu/rcu.h"
+#include "qemu/units.h"
 #include "block/block.h"
 #include "block/raw-aio.h"
 #include "qemu/coroutine.h"
@@ -26,6 +31,20 @@
 /* io_uring ring size */
 #define MAX_ENTRIES 128
 
+/*
+ * Size of the registered file table of each ring.  Files are registered at
+ * the index equal to their fd, so that no lookup is needed on submission;
+ * higher fds are submitted without registration.
+ */
+#define MAX_FIXED_FILES 1024
+
+/*
+ * Size of the fixed buffer table of each ring.  The kernel limits each fixed
+ * buffer to 1 GiB, so larger ranges use several entries.
+ */
+#define MAX_FIXED_BUFS 1024
+#define FIXED_BUF_MAX_SIZE (1 * GiB)
+
 typedef struct LuringAIOCB {
     Coroutine *co;
     struct io_uring_sqe sqeq;
@@ -58,8 +77,58 @@ struct LuringState {
     LuringQueue io_q;
 
     QEMUBH *completion_bh;
+
+    /*
+     * Entries of the registered file and fixed buffer tables that are in use
+     * in this ring.  Updated with luring_fixed_lock held, read without it by
+     * the home thread.
+     */
+    DECLARE_BITMAP(fixed_files, MAX_FIXED_FILES);
+    DECLARE_BITMAP(fixed_bufs, MAX_FIXED_BUFS);
+
+    /* Only rings with registered file and buffer tables are in the list */
+    QLIST_ENTRY(LuringState) next;
 };
 
+typedef struct LuringFixedBuf {
+    void *host;
+    size_t size;
+    unsigned index;
+} LuringFixedBuf;
+
+typedef struct LuringFixedBufs {
+    struct rcu_head rcu;
+    unsigned nr;
+    LuringFixedBuf bufs[];
+} LuringFixedBufs;
+
+/* A range passed to luring_register_buf() */
+typedef struct LuringBufRange {
+    void *host;
+    size_t size;
+    unsigned refcnt;
+    QLIST_ENTRY(LuringBufRange) next;
+} LuringBufRange;
+
+/*
+ * Files and buffers are registered in every ring, because requests for a
+ * BlockDriverState are submitted to the ring of whichever AioContext they run
+ * in.  luring_fixed_lock protects the variables below.
+ */
+static QemuMutex luring_fixed_lock;
+static QLIST_HEAD(, LuringState) luring_rings;
+static DECLARE_BITMAP(luring_files, MAX_FIXED_FILES);
+static DECLARE_BITMAP(luring_buf_indexes, MAX_FIXED_BUFS);
+static QLIST_HEAD(, LuringBufRange) luring_buf_ranges;
+
+/* Also read under RCU on submission */
+static LuringFixedBufs *luring_fixed_bufs;
+
+static void __attribute__((constructor)) luring_fixed_init(void)
+{
+    qemu_mutex_init(&luring_fixed_lock);
+}
+
 /**
  * luring_resubmit:
  *
@@ -90,6 +159,15 @@ static void luring_resubmit_short_read(LuringState *s, LuringAIOCB *luringcb,
     luringcb->total_read += nread;
     remaining = luringcb->qiov->size - luringcb->total_read;
 
+    if (luringcb->sqeq.opcode == IORING_OP_READ_FIXED) {
+        /* The rest of the buffer is still inside the same fixed buffer */
+        luringcb->sqeq.off += nread;
+        luringcb->sqeq.addr += nread;
+        luringcb->sqeq.len = remaining;
+        luring_resubmit(s, luringcb);
+        return;
+    }
+
     /* Shorten qiov */
     resubmit_qiov = &luringcb->resubmit_qiov;
     if (resubmit_qiov->iov == NULL) {
@@ -323,6 +401,39 @@ static void luring_deferred_fn(void *opaque)
     }
 }
 
+/*
+ * Return the index of the fixed buffer that contains the single buffer of
+ * @qiov in ring @s, or -1 if there is none.
+ */
+static int luring_fixed_buf_index(LuringState *s, QEMUIOVector *qiov)
+{
+    uintptr_t start = (uintptr_t)qiov->iov[0].iov_base;
+    uintptr_t end = start + qiov->iov[0].iov_len;
+    LuringFixedBufs *fixed;
+    unsigned i;
+
+    if (qiov->niov != 1) {
+        return -1;
+    }
+
+    RCU_READ_LOCK_GUARD();
+
+    fixed = qatomic_rcu_read(&luring_fixed_bufs);
+    if (!fixed) {
+        return -1;
+    }
+
+    for (i = 0; i < fixed->nr; i++) {
+        LuringFixedBuf *buf = &fixed->bufs[i];
+
+        if (start >= (uintptr_t)buf->host &&
+            end <= (uintptr_t)buf->host + buf->size) {
+            return test_bit(buf->index, s->fixed_bufs) ? buf->index : -1;
+        }
+    }
+    return -1;
+}
+
 /**
  * luring_do_submit:
  * @fd: file descriptor for I/O
@@ -338,10 +449,20 @@ static int luring_do_submit(int fd, LuringAIOCB *luringcb, LuringState *s,
                             uint64_t offset, int type)
 {
     int ret;
+    int buf_index = -1;
     struct io_uring_sqe *sqes = &luringcb->sqeq;
 
+    if (type == QEMU_AIO_WRITE || type == QEMU_AIO_READ) {
+        buf_index = luring_fixed_buf_index(s, luringcb->qiov);
+    }
+
     switch (type) {
     case QEMU_AIO_WRITE:
+        if (buf_index >= 0) {
+            io_uring_prep_write_fixed(sqes, fd, luringcb->qiov->iov[0].iov_base,
+                                      luringcb->qiov->size, offset, buf_index);
+            break;
+        }
         io_uring_prep_writev(sqes, fd, luringcb->qiov->iov,
                              luringcb->qiov->niov, offset);
         break;
@@ -350,6 +471,11 @@ static int luring_do_submit(int fd, LuringAIOCB *luringcb, LuringState *s,
                              luringcb->qiov->niov, offset);
         break;
     case QEMU_AIO_READ:
+        if (buf_index >= 0) {
+            io_uring_prep_read_fixed(sqes, fd, luringcb->qiov->iov[0].iov_base,
+                                     luringcb->qiov->size, offset, buf_index);
+            break;
+        }
         io_uring_prep_readv(sqes, fd, luringcb->qiov->iov,
                             luringcb->qiov->niov, offset);
         break;
@@ -361,6 +487,10 @@ static int luring_do_submit(int fd, LuringAIOCB *luringcb, LuringState *s,
                         __func__, type);
         abort();
     }
+    if (fd < MAX_FIXED_FILES && test_bit(fd, s->fixed_files)) {
+        /* The registered file's index is its fd */
+        sqes->flags |= IOSQE_FIXED_FILE;
+    }
     io_uring_sqe_set_data(sqes, luringcb);
 
     QSIMPLEQ_INSERT_TAIL(&s->io_q.submit_queue, luringcb, next);
@@ -422,6 +552,262 @@ void luring_attach_aio_context(LuringState *s, AioContext *new_context)
                        qemu_luring_poll_cb, qemu_luring_poll_ready, s);
 }
 
+#ifdef HAVE_IO_URING_REGISTER_SPARSE
+/* Called with luring_fixed_lock held */
+static void luring_update_fixed_file(LuringState *s, int fd, bool add)
+{
+    int value = add ? fd : -1;
+    int ret;
+
+    if (!add) {
+        clear_bit_atomic(fd, s->fixed_files);
+    }
+    ret = io_uring_register_files_update(&s->ring, fd, &value, 1);
+    trace_luring_update_fixed_file(s, fd, add, ret);
+    if (add && ret == 1) {
+        set_bit_atomic(fd, s->fixed_files);
+    }
+}
+
+/* Called with luring_fixed_lock held */
+static int luring_update_fixed_buf(LuringState *s, const LuringFixedBuf *buf,
+                                   bool add)
+{
+    struct iovec iov = { };
+    int ret;
+
+    if (add) {
+        iov.iov_base = buf->host;
+        iov.iov_len = buf->size;
+    } else {
+        if (!test_bit(buf->index, s->fixed_bufs)) {
+            return 0;
+        }
+        clear_bit_atomic(buf->index, s->fixed_bufs);
+    }
+
+    ret = io_uring_register_buffers_update_tag(&s->ring, buf->index, &iov,
+                                               NULL, 1);
+    trace_luring_update_fixed_buf(s, buf->index, iov.iov_base, iov.iov_len,
+                                  ret);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (add) {
+        set_bit_atomic(buf->index, s->fixed_bufs);
+    }
+    return 0;
+}
+
+/* Create the registered file and buffer tables and fill in existing entries */
+static void luring_init_fixed(LuringState *s)
+{
+    LuringFixedBufs *fixed;
+    unsigned long fd;
+    unsigned i;
+    int ret;
+
+    ret = io_uring_register_files_sparse(&s->ring, MAX_FIXED_FILES);
+    if (ret == 0) {
+        ret = io_uring_register_buffers_sparse(&s->ring, MAX_FIXED_BUFS);
+    }
+    trace_luring_init_fixed(s, ret);
+    if (ret < 0) {
+        /* Not supported by the kernel, use plain fds and iovecs */
+        return;
+    }
+
+    QEMU_LOCK_GUARD(&luring_fixed_lock);
+
+    QLIST_INSERT_HEAD(&luring_rings, s, next);
+
+    for (fd = find_first_bit(luring_files, MAX_FIXED_FILES);
+         fd < MAX_FIXED_FILES;
+         fd = find_next_bit(luring_files, MAX_FIXED_FILES, fd + 1)) {
+        luring_update_fixed_file(s, fd, true);
+    }
+
+    fixed = luring_fixed_bufs;
+    for (i = 0; fixed && i < fixed->nr; i++) {
+        ret = luring_update_fixed_buf(s, &fixed->bufs[i], true);
+        if (ret < 0) {
+            /* Requests on this buffer fall back to iovecs in this ring */
+            warn_report("Failed to register %p size %zu as io_uring fixed "
+                        "buffer: %s", fixed->bufs[i].host, fixed->bufs[i].size,
+                        strerror(-ret));
+        }
+    }
+}
+#endif /* HAVE_IO_URING_REGISTER_SPARSE */
+
+void luring_register_fd(int fd)
+{
+#ifdef HAVE_IO_URING_REGISTER_SPARSE
+    LuringState *s;
+
+    if (fd < 0 || fd >= MAX_FIXED_FILES) {
+        return;
+    }
+
+    QEMU_LOCK_GUARD(&luring_fixed_lock);
+
+    set_bit(fd, luring_files);
+    QLIST_FOREACH(s, &luring_rings, next) {
+        luring_update_fixed_file(s, fd, true);
+    }
+#endif
+}
+
+void luring_unregister_fd(int fd)
+{
+#ifdef HAVE_IO_URING_REGISTER_SPARSE
+    LuringState *s;
+
+    if (fd < 0 || fd >= MAX_FIXED_FILES) {
+        return;
+    }
+
+    QEMU_LOCK_GUARD(&luring_fixed_lock);
+
+    if (!test_and_clear_bit(fd, luring_files)) {
+        return;
+    }
+    QLIST_FOREACH(s, &luring_rings, next) {
+        luring_update_fixed_file(s, fd, false);
+    }
+#endif
+}
+
+bool luring_register_buf(void *host, size_t size, Error **errp)
+{
+#ifdef HAVE_IO_URING_REGISTER_SPARSE
+    LuringFixedBufs *old, *new;
+    LuringBufRange *range;
+    LuringState *s;
+    unsigned old_nr, nr, i, j;
+    int ret;
+
+    QEMU_LOCK_GUARD(&luring_fixed_lock);
+
+    QLIST_FOREACH(range, &luring_buf_ranges, next) {
+        if (range->host == host && range->size == size) {
+            range->refcnt++;
+            return true;
+        }
+    }
+
+    old = luring_fixed_bufs;
+    old_nr = old ? old->nr : 0;
+    nr = DIV_ROUND_UP(size, FIXED_BUF_MAX_SIZE);
+    if (old_nr + nr > MAX_FIXED_BUFS) {
+        error_setg(errp, "Cannot register %p size %zu as io_uring fixed "
+                   "buffer: too many fixed buffers", host, size);
+        return false;
+    }
+
+    new = g_malloc(sizeof(*new) + (old_nr + nr) * sizeof(new->bufs[0]));
+    if (old) {
+        memcpy(new->bufs, old->bufs, old_nr * sizeof(new->bufs[0]));
+    }
+
+    for (i = 0; i < nr; i++) {
+        LuringFixedBuf *buf = &new->bufs[old_nr + i];
+
+        buf->host = host + i * FIXED_BUF_MAX_SIZE;
+        buf->size = MIN(size - i * FIXED_BUF_MAX_SIZE, FIXED_BUF_MAX_SIZE);
+        buf->index = find_first_zero_bit(luring_buf_indexes, MAX_FIXED_BUFS);
+        set_bit(buf->index, luring_buf_indexes);
+
+        QLIST_FOREACH(s, &luring_rings, next) {
+            ret = luring_update_fixed_buf(s, buf, true);
+            if (ret < 0) {
+                error_setg_errno(errp, -ret, "Failed to register %p size %zu "
+                                 "as io_uring fixed buffer", host, size);
+                goto fail;
+            }
+        }
+    }
+
+    range = g_new(LuringBufRange, 1);
+    *range = (LuringBufRange) {
+        .host = host,
+        .size = size,
+        .refcnt = 1,
+    };
+    QLIST_INSERT_HEAD(&luring_buf_ranges, range, next);
+
+    new->nr = old_nr + nr;
+    qatomic_rcu_set(&luring_fixed_bufs, new);
+    if (old) {
+        g_free_rcu(old, rcu);
+    }
+    return true;
+
+fail:
+    for (j = 0; j <= i; j++) {
+        LuringFixedBuf *buf = &new->bufs[old_nr + j];
+
+        QLIST_FOREACH(s, &luring_rings, next) {
+            luring_update_fixed_buf(s, buf, false);
+        }
+        clear_bit(buf->index, luring_buf_indexes);
+    }
+    g_free(new);
+    return false;
+#else
+    return true;
+#endif
+}
+
+void luring_unregister_buf(void *host, size_t size)
+{
+#ifdef HAVE_IO_URING_REGISTER_SPARSE
+    LuringFixedBufs *old, *new;
+    LuringBufRange *range;
+    LuringState *s;
+    unsigned i;
+
+    QEMU_LOCK_GUARD(&luring_fixed_lock);
+
+    QLIST_FOREACH(range, &luring_buf_ranges, next) {
+        if (range->host == host && range->size == size) {
+            break;
+        }
+    }
+    if (!range || --range->refcnt > 0) {
+        return;
+    }
+    QLIST_REMOVE(range, next);
+    g_free(range);
+
+    old = luring_fixed_bufs;
+    new = g_malloc(sizeof(*new) + old->nr * sizeof(new->bufs[0]));
+    new->nr = 0;
+
+    for (i = 0; i < old->nr; i++) {
+        LuringFixedBuf *buf = &old->bufs[i];
+
+        if (buf->host < host || buf->host >= host + size) {
+            new->bufs[new->nr++] = *buf;
+            continue;
+        }
+
+        QLIST_FOREACH(s, &luring_rings, next) {
+            luring_update_fixed_buf(s, buf, false);
+        }
+        clear_bit(buf->index, luring_buf_indexes);
+    }
+
+    if (new->nr == 0) {
+        g_free(new);
+        new = NULL;
+    }
+    qatomic_rcu_set(&luring_fixed_bufs, new);
+    g_free_rcu(old, rcu);
+#endif
+}
+
 LuringState *luring_init(Error **errp)
 {
     int rc;
@@ -437,6 +823,16 @@ LuringState *luring_init(Error **errp)
         return NULL;
     }
 
+    /*
+     * Do not use io_uring_register_ring_fd(): the registration is per task,
+     * but the main loop's LuringState is also submitted to from vCPU and
+     * migration threads that hold the BQL.
+     */
+
+#ifdef HAVE_IO_URING_REGISTER_SPARSE
+    luring_init_fixed(s);
+#endif
+
     ioq_init(&s->io_q);
     return s;
 
@@ -444,6 +840,11 @@ LuringState *luring_init(Error **errp)
 
 void luring_cleanup(LuringState *s)
 {
+    WITH_QEMU_LOCK_GUARD(&luring_fixed_lock) {
+        if (QLIST_IS_INSERTED(s, next)) {
+            QLIST_REMOVE(s, next);
+        }
+    }
     io_uring_queue_exit(&s->ring);
     trace_luring_cleanup_state(s);
     g_free(s);
@@ -25,9 +25,12 @@
 #include "qemu/bitmap.h"
 #include "qemu/memalign.h"
 
-#define MAX_IN_FLIGHT 16
+/* Bounds of the in-flight window, see mirror_adapt_in_flight() */
+#define DEFAULT_IN_FLIGHT 16
+#define MIN_IN_FLIGHT 4
+#define MAX_IN_FLIGHT 64
 #define MAX_IO_BYTES (1 << 20) /* 1 Mb */
-#define DEFAULT_MIRROR_BUF_SIZE (MAX_IN_FLIGHT * MAX_IO_BYTES)
+#define DEFAULT_MIRROR_BUF_SIZE (DEFAULT_IN_FLIGHT * MAX_IO_BYTES)
 
 /* The mirroring buffer is a list of granularity-sized chunks.
  * Free chunks are organized in a list.
@@ -82,7 +85,15 @@ typedef struct MirrorBlockJob {
     uint64_t last_pause_ns;
     unsigned long *in_flight_bitmap;
     unsigned in_flight;
+    unsigned max_in_flight;
     int64_t bytes_in_flight;
+    /* Throughput measurement for mirror_adapt_in_flight() */
+    int adapt_step;
+    bool adapt_window_full;
+    bool adapt_buf_empty;
+    int64_t adapt_start_ns;
+    int64_t adapt_bytes;
+    uint64_t adapt_prev_bw;
     QTAILQ_HEAD(, MirrorOp) ops_in_flight;
     int ret;
     bool unmap;
@@ -242,6 +253,8 @@ static void coroutine_fn mirror_write_complete(MirrorOp *op, int ret)
         if (action == BLOCK_ERROR_ACTION_REPORT && s->ret >= 0) {
             s->ret = ret;
         }
+    } else {
+        s->adapt_bytes += op->bytes;
     }
 
     mirror_iteration_done(op, ret);
@@ -374,6 +387,7 @@ static void coroutine_fn mirror_co_read(void *opaque)
     nb_chunks = DIV_ROUND_UP(op->bytes, s->granularity);
 
     while (s->buf_free_count < nb_chunks) {
+        s->adapt_buf_empty = true;
         trace_mirror_yield_in_flight(s, op->offset, s->in_flight);
         mirror_wait_for_free_in_flight_slot(s);
     }
@@ -487,7 +501,7 @@ static void coroutine_fn GRAPH_UNLOCKED mirror_iteration(MirrorBlockJob *s)
     /* At least the first dirty chunk is mirrored in one iteration. */
     int nb_chunks = 1;
     bool write_zeroes_ok = bdrv_can_write_zeroes_with_unmap(blk_bs(s->target));
-    int max_io_bytes = MAX(s->buf_size / MAX_IN_FLIGHT, MAX_IO_BYTES);
+    int max_io_bytes = MAX(s->buf_size / DEFAULT_IN_FLIGHT, MAX_IO_BYTES);
 
     bdrv_graph_co_rdlock();
     source = s->mirror_top_bs->backing->bs;
@@ -599,7 +613,8 @@ static void coroutine_fn GRAPH_UNLOCKED mirror_iteration(MirrorBlockJob *s)
             }
         }
 
-        while (s->in_flight >= MAX_IN_FLIGHT) {
+        while (s->in_flight >= s->max_in_flight) {
+            s->adapt_window_full = true;
             trace_mirror_yield_in_flight(s, offset, s->in_flight);
             mirror_wait_for_free_in_flight_slot(s);
         }
@@ -819,6 +834,65 @@ static void mirror_abort(Job *job)
     assert(ret == 0);
 }
 
+/*
+ * Tune the number of concurrent operations from the throughput to the target,
+ * measured over periods of BLOCK_JOB_SLICE_TIME. Copies, zero writes and
+ * discards all count, since they all take a slot in the window. While
+ * throughput improves noticeably the window keeps growing (or shrinking),
+ * when it gets worse the direction is reversed and when it makes no
+ * difference the window shrinks so that fewer requests compete with the
+ * guest.
+ *
+ * Periods in which the window was never full say nothing about its size and
+ * are discarded. So are periods in which copies ran out of buffer space: each
+ * copy holds at least one granularity-sized chunk of the buf_size bytes of
+ * buffer until its write completes, so when the buffer is the limit a larger
+ * window could not have added copies.
+ */
+static void mirror_adapt_in_flight(MirrorBlockJob *s)
+{
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    int64_t elapsed = now - s->adapt_start_ns;
+    unsigned new_max;
+    uint64_t bw;
+
+    if (elapsed < BLOCK_JOB_SLICE_TIME) {
+        return;
+    }
+
+    /* Ignore periods that included a pause, an idle source or no free buffer */
+    if (!s->adapt_window_full || s->adapt_buf_empty ||
+        elapsed > 4 * BLOCK_JOB_SLICE_TIME) {
+        goto reset;
+    }
+
+    bw = s->adapt_bytes * NANOSECONDS_PER_SECOND / elapsed;
+    if (s->adapt_prev_bw) {
+        if (bw < s->adapt_prev_bw - s->adapt_prev_bw / 8) {
+            s->adapt_step = -s->adapt_step;
+        } else if (bw <= s->adapt_prev_bw + s->adapt_prev_bw / 8) {
+            s->adapt_step = -1;
+        }
+    }
+
+    new_max = s->adapt_step > 0 ? s->max_in_flight * 2 : s->max_in_flight / 2;
+    new_max = MIN(MAX(new_max, MIN_IN_FLIGHT), MAX_IN_FLIGHT);
+    if (new_max == s->max_in_flight) {
+        /* Hit a limit, try the other direction next time */
+        s->adapt_step = -s->adapt_step;
+    } else {
+        trace_mirror_adapt_in_flight(s, new_max, bw);
+        s->max_in_flight = new_max;
+    }
+    s->adapt_prev_bw = bw;
+
+reset:
+    s->adapt_window_full = false;
+    s->adapt_buf_empty = false;
+    s->adapt_start_ns = now;
+    s->adapt_bytes = 0;
+}
+
 static void coroutine_fn mirror_throttle(MirrorBlockJob *s)
 {
     int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
@@ -861,7 +935,7 @@ static int coroutine_fn GRAPH_UNLOCKED mirror_dirty_init(MirrorBlockJob *s)
                 return 0;
             }
 
-            if (s->in_flight >= MAX_IN_FLIGHT) {
+            if (s->in_flight >= s->max_in_flight) {
                 trace_mirror_yield(s, UINT64_MAX, s->buf_free_count,
                                    s->in_flight);
                 mirror_wait_for_free_in_flight_slot(s);
@@ -1014,7 +1088,10 @@ static int coroutine_fn mirror_run(Job *job, Error **errp)
 
     mirror_free_init(s);
 
+    s->max_in_flight = DEFAULT_IN_FLIGHT;
+    s->adapt_step = 1;
     s->last_pause_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    s->adapt_start_ns = s->last_pause_ns;
     if (!s->is_none_mode) {
         ret = mirror_dirty_init(s);
         if (ret < 0 || job_is_cancelled(&s->common.job)) {
@@ -1054,6 +1131,8 @@ static int coroutine_fn mirror_run(Job *job, Error **errp)
                                    s->bytes_in_flight + cnt +
                                    s->active_write_bytes_in_flight);
 
+        mirror_adapt_in_flight(s);
+
         /* Note that even when no rate limit is applied we need to yield
          * periodically with no pending I/O so that bdrv_drain_all() returns.
          * We do so every BLKOCK_JOB_SLICE_TIME nanoseconds, or when there is
@@ -1064,8 +1143,14 @@ static int coroutine_fn mirror_run(Job *job, Error **errp)
         }
         if (delta < BLOCK_JOB_SLICE_TIME &&
             iostatus == BLOCK_DEVICE_IO_STATUS_OK) {
-            if (s->in_flight >= MAX_IN_FLIGHT || s->buf_free_count == 0 ||
+            if (s->in_flight >= s->max_in_flight ||
+                s->buf_free_count == 0 ||
                 (cnt == 0 && s->in_flight > 0)) {
+                if (s->in_flight >= s->max_in_flight) {
+                    s->adapt_window_full = true;
+                } else if (s->buf_free_count == 0) {
+                    s->adapt_buf_empty = true;
+                }
                 trace_mirror_yield(s, cnt, s->buf_free_count, s->in_flight);
                 mirror_wait_for_free_in_flight_slot(s);
                 continue;
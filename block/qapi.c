@@ -497,43 +497,57 @@ static void bdrv_query_blk_stats(BlockDeviceStats *ds, BlockBackend *blk)
     BlockAcctTimedStats *ts = NULL;
     BlockLatencyHistogram *hgram;
 
-    ds->rd_bytes = stats->nr_bytes[BLOCK_ACCT_READ];
-    ds->wr_bytes = stats->nr_bytes[BLOCK_ACCT_WRITE];
-    ds->zone_append_bytes = stats->nr_bytes[BLOCK_ACCT_ZONE_APPEND];
-    ds->unmap_bytes = stats->nr_bytes[BLOCK_ACCT_UNMAP];
-    ds->rd_operations = stats->nr_ops[BLOCK_ACCT_READ];
-    ds->wr_operations = stats->nr_ops[BLOCK_ACCT_WRITE];
-    ds->zone_append_operations = stats->nr_ops[BLOCK_ACCT_ZONE_APPEND];
-    ds->unmap_operations = stats->nr_ops[BLOCK_ACCT_UNMAP];
-
-    ds->failed_rd_operations = stats->failed_ops[BLOCK_ACCT_READ];
-    ds->failed_wr_operations = stats->failed_ops[BLOCK_ACCT_WRITE];
+    ds->rd_bytes = stat64_get(&stats->nr_bytes[BLOCK_ACCT_READ]);
+    ds->wr_bytes = stat64_get(&stats->nr_bytes[BLOCK_ACCT_WRITE]);
+    ds->zone_append_bytes =
+        stat64_get(&stats->nr_bytes[BLOCK_ACCT_ZONE_APPEND]);
+    ds->unmap_bytes = stat64_get(&stats->nr_bytes[BLOCK_ACCT_UNMAP]);
+    ds->rd_operations = stat64_get(&stats->nr_ops[BLOCK_ACCT_READ]);
+    ds->wr_operations = stat64_get(&stats->nr_ops[BLOCK_ACCT_WRITE]);
+    ds->zone_append_operations =
+        stat64_get(&stats->nr_ops[BLOCK_ACCT_ZONE_APPEND]);
+    ds->unmap_operations = stat64_get(&stats->nr_ops[BLOCK_ACCT_UNMAP]);
+
+    ds->failed_rd_operations =
+        stat64_get(&stats->failed_ops[BLOCK_ACCT_READ]);
+    ds->failed_wr_operations =
+        stat64_get(&stats->failed_ops[BLOCK_ACCT_WRITE]);
     ds->failed_zone_append_operations =
-        stats->failed_ops[BLOCK_ACCT_ZONE_APPEND];
-    ds->failed_flush_operations = stats->failed_ops[BLOCK_ACCT_FLUSH];
-    ds->failed_unmap_operations = stats->failed_ops[BLOCK_ACCT_UNMAP];
-
-    ds->invalid_rd_operations = stats->invalid_ops[BLOCK_ACCT_READ];
-    ds->invalid_wr_operations = stats->invalid_ops[BLOCK_ACCT_WRITE];
+        stat64_get(&stats->failed_ops[BLOCK_ACCT_ZONE_APPEND]);
+    ds->failed_flush_operations =
+        stat64_get(&stats->failed_ops[BLOCK_ACCT_FLUSH]);
+    ds->failed_unmap_operations =
+        stat64_get(&stats->failed_ops[BLOCK_ACCT_UNMAP]);
+
+    ds->invalid_rd_operations =
+        stat64_get(&stats->invalid_ops[BLOCK_ACCT_READ]);
+    ds->invalid_wr_operations =
+        stat64_get(&stats->invalid_ops[BLOCK_ACCT_WRITE]);
     ds->invalid_zone_append_operations =
-        stats->invalid_ops[BLOCK_ACCT_ZONE_APPEND];
+        stat64_get(&stats->invalid_ops[BLOCK_ACCT_ZONE_APPEND]);
     ds->invalid_flush_operations =
-        stats->invalid_ops[BLOCK_ACCT_FLUSH];
-    ds->invalid_unmap_operations = stats->invalid_ops[BLOCK_ACCT_UNMAP];
-
-    ds->rd_merged = stats->merged[BLOCK_ACCT_READ];
-    ds->wr_merged = stats->merged[BLOCK_ACCT_WRITE];
-    ds->zone_append_merged = stats->merged[BLOCK_ACCT_ZONE_APPEND];
-    ds->unmap_merged = stats->merged[BLOCK_ACCT_UNMAP];
-    ds->flush_operations = stats->nr_ops[BLOCK_ACCT_FLUSH];
-    ds->wr_total_time_ns = stats->total_time_ns[BLOCK_ACCT_WRITE];
+        stat64_get(&stats->invalid_ops[BLOCK_ACCT_FLUSH]);
+    ds->invalid_unmap_operations =
+        stat64_get(&stats->invalid_ops[BLOCK_ACCT_UNMAP]);
+
+    ds->rd_merged = stat64_get(&stats->merged[BLOCK_ACCT_READ]);
+    ds->wr_merged = stat64_get(&stats->merged[BLOCK_ACCT_WRITE]);
+    ds->zone_append_merged =
+        stat64_get(&stats->merged[BLOCK_ACCT_ZONE_APPEND]);
+    ds->unmap_merged = stat64_get(&stats->merged[BLOCK_ACCT_UNMAP]);
+    ds->flush_operations = stat64_get(&stats->nr_ops[BLOCK_ACCT_FLUSH]);
+    ds->wr_total_time_ns =
+        stat64_get(&stats->total_time_ns[BLOCK_ACCT_WRITE]);
     ds->zone_append_total_time_ns =
-        stats->total_time_ns[BLOCK_ACCT_ZONE_APPEND];
-    ds->rd_total_time_ns = stats->total_time_ns[BLOCK_ACCT_READ];
-    ds->flush_total_time_ns = stats->total_time_ns[BLOCK_ACCT_FLUSH];
-    ds->unmap_total_time_ns = stats->total_time_ns[BLOCK_ACCT_UNMAP];
-
-    ds->has_idle_time_ns = stats->last_access_time_ns > 0;
+        stat64_get(&stats->total_time_ns[BLOCK_ACCT_ZONE_APPEND]);
+    ds->rd_total_time_ns =
+        stat64_get(&stats->total_time_ns[BLOCK_ACCT_READ]);
+    ds->flush_total_time_ns =
+        stat64_get(&stats->total_time_ns[BLOCK_ACCT_FLUSH]);
+    ds->unmap_total_time_ns =
+        stat64_get(&stats->total_time_ns[BLOCK_ACCT_UNMAP]);
+
+    ds->has_idle_time_ns = stat64_get(&stats->last_access_time_ns) > 0;
     if (ds->has_idle_time_ns) {
         ds->idle_time_ns = block_acct_idle_time_ns(stats);
     }
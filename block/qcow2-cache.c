@@ -33,6 +33,8 @@ typedef struct Qcow2CachedTable {
     uint64_t lru_counter;
     int      ref;
     bool     dirty;
+    /* Referenced again after it was loaded, see qcow2_cache_do_get() */
+    bool     hot;
 } Qcow2CachedTable;
 
 struct Qcow2Cache {
@@ -44,6 +46,13 @@ struct Qcow2Cache {
     void                   *table_array;
     uint64_t                lru_counter;
     uint64_t                cache_clean_lru_counter;
+
+    /* Maps the offset of each cached table to its Qcow2CachedTable */
+    GHashTable             *lookup;
+
+    uint64_t                hits;
+    uint64_t                misses;
+    uint64_t                evictions;
 };
 
 static inline void *qcow2_cache_get_table_addr(Qcow2Cache *c, int table)
@@ -59,6 +68,21 @@ static inline int qcow2_cache_get_table_idx(Qcow2Cache *c, void *table)
     return idx;
 }
 
+/* The entry's offset must not be changed while it is in the lookup table */
+static void qcow2_cache_entry_set_offset(Qcow2Cache *c, int i, int64_t offset)
+{
+    Qcow2CachedTable *t = &c->entries[i];
+
+    if (t->offset) {
+        g_hash_table_remove(c->lookup, &t->offset);
+    }
+    t->offset = offset;
+    t->hot = false;
+    if (offset) {
+        g_hash_table_insert(c->lookup, &t->offset, t);
+    }
+}
+
 static inline const char *qcow2_cache_get_name(BDRVQcow2State *s, Qcow2Cache *c)
 {
     if (c == s->refcount_block_cache) {
@@ -106,7 +130,7 @@ void qcow2_cache_clean_unused(Qcow2Cache *c)
 
         /* And count how many we can clean in a row */
         while (i < c->size && can_clean_entry(c, i)) {
-            c->entries[i].offset = 0;
+            qcow2_cache_entry_set_offset(c, i, 0);
             c->entries[i].lru_counter = 0;
             i++;
             to_clean++;
@@ -137,8 +161,10 @@ Qcow2Cache *qcow2_cache_create(BlockDriverState *bs, int num_tables,
     c->entries = g_try_new0(Qcow2CachedTable, num_tables);
     c->table_array = qemu_try_blockalign(bs->file->bs,
                                          (size_t) num_tables * c->table_size);
+    c->lookup = g_hash_table_new(g_int64_hash, g_int64_equal);
 
     if (!c->entries || !c->table_array) {
+        g_hash_table_destroy(c->lookup);
         qemu_vfree(c->table_array);
         g_free(c->entries);
         g_free(c);
@@ -156,6 +182,7 @@ int qcow2_cache_destroy(Qcow2Cache *c)
         assert(c->entries[i].ref == 0);
     }
 
+    g_hash_table_destroy(c->lookup);
     qemu_vfree(c->table_array);
     g_free(c->entries);
     g_free(c);
@@ -311,7 +338,9 @@ int qcow2_cache_empty(BlockDriverState *bs, Qcow2Cache *c)
         assert(c->entries[i].ref == 0);
         c->entries[i].offset = 0;
         c->entries[i].lru_counter = 0;
+        c->entries[i].hot = false;
     }
+    g_hash_table_remove_all(c->lookup);
 
     qcow2_cache_table_release(c, 0, c->size);
 
@@ -320,16 +349,64 @@ int qcow2_cache_empty(BlockDriverState *bs, Qcow2Cache *c)
     return 0;
 }
 
+/*
+ * Pick the entry to replace on a cache miss, or return -1 if all entries are
+ * in use.
+ *
+ * This is a simplified 2Q policy: tables that have only been used once (or
+ * only in a quick burst, like a sequential scan through an L2 table) are
+ * "cold" and are evicted first, as long as they occupy at least a quarter of
+ * the cache.  Tables that were referenced again later on are "hot" and are
+ * only evicted once the cold part of the cache has shrunk below that, so a
+ * single scan over a large image does not flush the working set.
+ */
+static int qcow2_cache_find_victim(Qcow2Cache *c)
+{
+    uint64_t min_cold_lru = UINT64_MAX, min_hot_lru = UINT64_MAX;
+    int cold_index = -1, hot_index = -1;
+    int nb_cold = 0;
+    int i;
+
+    for (i = 0; i < c->size; i++) {
+        const Qcow2CachedTable *t = &c->entries[i];
+
+        if (t->offset == 0) {
+            /* Use free entries first */
+            if (t->ref == 0) {
+                return i;
+            }
+            continue;
+        }
+        if (!t->hot) {
+            nb_cold++;
+        }
+        if (t->ref != 0) {
+            continue;
+        }
+        if (t->hot && t->lru_counter < min_hot_lru) {
+            min_hot_lru = t->lru_counter;
+            hot_index = i;
+        } else if (!t->hot && t->lru_counter < min_cold_lru) {
+            min_cold_lru = t->lru_counter;
+            cold_index = i;
+        }
+    }
+
+    if (cold_index >= 0 && (nb_cold >= c->size / 4 || hot_index < 0)) {
+        return cold_index;
+    }
+    return hot_index >= 0 ? hot_index : cold_index;
+}
+
 static int GRAPH_RDLOCK
 qcow2_cache_do_get(BlockDriverState *bs, Qcow2Cache *c, uint64_t offset,
                    void **table, bool read_from_disk)
 {
     BDRVQcow2State *s = bs->opaque;
+    Qcow2CachedTable *t;
+    int64_t key = offset;
     int i;
     int ret;
-    int lookup_index;
-    uint64_t min_lru_counter = UINT64_MAX;
-    int min_lru_index = -1;
 
     assert(offset != 0);
 
@@ -344,29 +421,34 @@ qcow2_cache_do_get(BlockDriverState *bs, Qcow2Cache *c, uint64_t offset,
     }
 
     /* Check if the table is already cached */
-    i = lookup_index = (offset / c->table_size * 4) % c->size;
-    do {
-        const Qcow2CachedTable *t = &c->entries[i];
-        if (t->offset == offset) {
-            goto found;
-        }
-        if (t->ref == 0 && t->lru_counter < min_lru_counter) {
-            min_lru_counter = t->lru_counter;
-            min_lru_index = i;
-        }
-        if (++i == c->size) {
-            i = 0;
+    t = g_hash_table_lookup(c->lookup, &key);
+    if (t) {
+        i = t - c->entries;
+        c->hits++;
+
+        /*
+         * References that come shortly after the previous one are part of
+         * the same burst of accesses and do not make the table hot.
+         */
+        if (!t->hot && t->ref == 0 &&
+            c->lru_counter - t->lru_counter > c->size / 4) {
+            t->hot = true;
         }
-    } while (i != lookup_index);
+        goto found;
+    }
 
-    if (min_lru_index == -1) {
+    i = qcow2_cache_find_victim(c);
+    if (i == -1) {
         /* This can't happen in current synchronous code, but leave the check
          * here as a reminder for whoever starts using AIO with the cache */
         abort();
     }
 
     /* Cache miss: write a table back and replace it */
-    i = min_lru_index;
+    c->misses++;
+    if (c->entries[i].offset) {
+        c->evictions++;
+    }
     trace_qcow2_cache_get_replace_entry(qemu_coroutine_self(),
                                         c == s->l2_table_cache, i);
 
@@ -377,7 +459,7 @@ qcow2_cache_do_get(BlockDriverState *bs, Qcow2Cache *c, uint64_t offset,
 
     trace_qcow2_cache_get_read(qemu_coroutine_self(),
                                c == s->l2_table_cache, i);
-    c->entries[i].offset = 0;
+    qcow2_cache_entry_set_offset(c, i, 0);
     if (read_from_disk) {
         if (c == s->l2_table_cache) {
             BLKDBG_EVENT(bs->file, BLKDBG_L2_LOAD);
@@ -390,7 +472,7 @@ qcow2_cache_do_get(BlockDriverState *bs, Qcow2Cache *c, uint64_t offset,
         }
     }
 
-    c->entries[i].offset = offset;
+    qcow2_cache_entry_set_offset(c, i, offset);
 
     /* And return the right table */
 found:
@@ -438,14 +520,10 @@ void qcow2_cache_entry_mark_dirty(Qcow2Cache *c, void *table)
 
 void *qcow2_cache_is_table_offset(Qcow2Cache *c, uint64_t offset)
 {
-    int i;
+    int64_t key = offset;
+    Qcow2CachedTable *t = g_hash_table_lookup(c->lookup, &key);
 
-    for (i = 0; i < c->size; i++) {
-        if (c->entries[i].offset == offset) {
-            return qcow2_cache_get_table_addr(c, i);
-        }
-    }
-    return NULL;
+    return t ? qcow2_cache_get_table_addr(c, t - c->entries) : NULL;
 }
 
 void qcow2_cache_discard(Qcow2Cache *c, void *table)
@@ -454,9 +532,18 @@ void qcow2_cache_discard(Qcow2Cache *c, void *table)
 
     assert(c->entries[i].ref == 0);
 
-    c->entries[i].offset = 0;
+    qcow2_cache_entry_set_offset(c, i, 0);
     c->entries[i].lru_counter = 0;
     c->entries[i].dirty = false;
 
     qcow2_cache_table_release(c, i, 1);
 }
+
+void qcow2_cache_get_stats(Qcow2Cache *c, Qcow2CacheStats *stats)
+{
+    *stats = (Qcow2CacheStats) {
+        .hits = c->hits,
+        .misses = c->misses,
+        .evictions = c->evictions,
+    };
+}
@@ -964,12 +964,68 @@ int qcow2_update_cluster_refcount(BlockDriverState *bs,
 
 
 
+/*
+ * Counts how many clusters starting at @cluster_index are free, stopping at
+ * @max clusters or at the end of the refcount block that covers
+ * @cluster_index, and stores the result in *count.  This lets the allocator
+ * look at a whole refcount block with a single cache lookup instead of one
+ * per cluster.
+ *
+ * Returns 0 on success and -errno on failure.
+ */
+static int GRAPH_RDLOCK
+count_free_clusters(BlockDriverState *bs, uint64_t cluster_index,
+                    uint64_t max, uint64_t *count)
+{
+    BDRVQcow2State *s = bs->opaque;
+    uint64_t refcount_table_index, block_index, n;
+    int64_t refcount_block_offset;
+    void *refcount_block;
+    int ret;
+
+    refcount_table_index = cluster_index >> s->refcount_block_bits;
+    block_index = cluster_index & (s->refcount_block_size - 1);
+    max = MIN(max, s->refcount_block_size - block_index);
+
+    refcount_block_offset = refcount_table_index < s->refcount_table_size ?
+        s->refcount_table[refcount_table_index] & REFT_OFFSET_MASK : 0;
+    if (!refcount_block_offset) {
+        /* No refcount block yet, so all clusters it would cover are free */
+        *count = max;
+        return 0;
+    }
+
+    if (offset_into_cluster(s, refcount_block_offset)) {
+        qcow2_signal_corruption(bs, true, -1, -1, "Refblock offset %#" PRIx64
+                                " unaligned (reftable index: %#" PRIx64 ")",
+                                refcount_block_offset, refcount_table_index);
+        return -EIO;
+    }
+
+    ret = qcow2_cache_get(bs, s->refcount_block_cache, refcount_block_offset,
+                          &refcount_block);
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (n = 0; n < max; n++) {
+        if (s->get_refcount(refcount_block, block_index + n) != 0) {
+            break;
+        }
+    }
+
+    qcow2_cache_put(s->refcount_block_cache, &refcount_block);
+
+    *count = n;
+    return 0;
+}
+
 /* return < 0 if error */
 static int64_t GRAPH_RDLOCK
 alloc_clusters_noref(BlockDriverState *bs, uint64_t size, uint64_t max)
 {
     BDRVQcow2State *s = bs->opaque;
-    uint64_t i, nb_clusters, refcount;
+    uint64_t i, nb_clusters, nb_free;
     int ret;
 
     /* We can't allocate clusters if they may still be queued for discard. */
@@ -978,15 +1034,21 @@ alloc_clusters_noref(BlockDriverState *bs, uint64_t size, uint64_t max)
     }
 
     nb_clusters = size_to_clusters(s, size);
-retry:
-    for(i = 0; i < nb_clusters; i++) {
-        uint64_t next_cluster_index = s->free_cluster_index++;
-        ret = qcow2_get_refcount(bs, next_cluster_index, &refcount);
-
+    i = 0;
+    while (i < nb_clusters) {
+        ret = count_free_clusters(bs, s->free_cluster_index, nb_clusters - i,
+                                  &nb_free);
         if (ret < 0) {
             return ret;
-        } else if (refcount != 0) {
-            goto retry;
+        }
+
+        if (nb_free == 0) {
+            /* Cluster in use: restart the search right after it */
+            s->free_cluster_index++;
+            i = 0;
+        } else {
+            s->free_cluster_index += nb_free;
+            i += nb_free;
         }
     }
 
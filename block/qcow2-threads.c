@@ -45,7 +45,7 @@ qcow2_co_process(BlockDriverState *bs, ThreadPoolFunc *func, void *arg)
     BDRVQcow2State *s = bs->opaque;
 
     qemu_co_mutex_lock(&s->lock);
-    while (s->nb_threads >= QCOW2_MAX_THREADS) {
+    while (s->nb_threads >= s->max_threads) {
         qemu_co_queue_wait(&s->thread_task_queue, &s->lock);
     }
     s->nb_threads++;
@@ -173,6 +173,61 @@ static ssize_t qcow2_zlib_decompress(void *dest, size_t dest_size,
 
 #ifdef CONFIG_ZSTD
 
+/*
+ * zstd contexts are relatively expensive to set up, so each worker thread
+ * keeps one compression and one decompression context around for all the
+ * clusters it processes.  They are freed when the thread exits.
+ */
+static __thread ZSTD_CCtx *zstd_cctx;
+static __thread ZSTD_DCtx *zstd_dctx;
+static __thread Notifier zstd_cleanup_notifier;
+
+static void qcow2_zstd_cleanup(Notifier *n, void *unused)
+{
+    ZSTD_freeCCtx(zstd_cctx);
+    ZSTD_freeDCtx(zstd_dctx);
+    zstd_cctx = NULL;
+    zstd_dctx = NULL;
+}
+
+static void qcow2_zstd_register_cleanup(void)
+{
+    if (!zstd_cleanup_notifier.notify) {
+        zstd_cleanup_notifier.notify = qcow2_zstd_cleanup;
+        qemu_thread_atexit_add(&zstd_cleanup_notifier);
+    }
+}
+
+static ZSTD_CCtx *qcow2_zstd_get_cctx(void)
+{
+    if (!zstd_cctx) {
+        zstd_cctx = ZSTD_createCCtx();
+        if (!zstd_cctx) {
+            return NULL;
+        }
+        qcow2_zstd_register_cleanup();
+    } else {
+        /* Drop any state left over by a failed compression */
+        ZSTD_CCtx_reset(zstd_cctx, ZSTD_reset_session_only);
+    }
+    return zstd_cctx;
+}
+
+static ZSTD_DCtx *qcow2_zstd_get_dctx(void)
+{
+    if (!zstd_dctx) {
+        zstd_dctx = ZSTD_createDCtx();
+        if (!zstd_dctx) {
+            return NULL;
+        }
+        qcow2_zstd_register_cleanup();
+    } else {
+        /* Drop any state left over by a failed or partial decompression */
+        ZSTD_DCtx_reset(zstd_dctx, ZSTD_reset_session_only);
+    }
+    return zstd_dctx;
+}
+
 /*
  * qcow2_zstd_compress()
  *
@@ -188,7 +243,6 @@ static ssize_t qcow2_zlib_decompress(void *dest, size_t dest_size,
 static ssize_t qcow2_zstd_compress(void *dest, size_t dest_size,
                                    const void *src, size_t src_size)
 {
-    ssize_t ret;
     size_t zstd_ret;
     ZSTD_outBuffer output = {
         .dst = dest,
@@ -200,7 +254,7 @@ static ssize_t qcow2_zstd_compress(void *dest, size_t dest_size,
         .size = src_size,
         .pos = 0
     };
-    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    ZSTD_CCtx *cctx = qcow2_zstd_get_cctx();
 
     if (!cctx) {
         return -EIO;
@@ -226,19 +280,15 @@ static ssize_t qcow2_zstd_compress(void *dest, size_t dest_size,
 
     if (zstd_ret) {
         if (zstd_ret > output.size - output.pos) {
-            ret = -ENOMEM;
+            return -ENOMEM;
         } else {
-            ret = -EIO;
+            return -EIO;
         }
-        goto out;
     }
 
     /* make sure that zstd didn't overflow the dest buffer */
     assert(output.pos <= dest_size);
-    ret = output.pos;
-out:
-    ZSTD_freeCCtx(cctx);
-    return ret;
+    return output.pos;
 }
 
 /*
@@ -268,7 +318,7 @@ static ssize_t qcow2_zstd_decompress(void *dest, size_t dest_size,
         .size = src_size,
         .pos = 0
     };
-    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    ZSTD_DCtx *dctx = qcow2_zstd_get_dctx();
 
     if (!dctx) {
         return -EIO;
@@ -319,7 +369,6 @@ static ssize_t qcow2_zstd_decompress(void *dest, size_t dest_size,
         ret = -EIO;
     }
 
-    ZSTD_freeDCtx(dctx);
     assert(ret == 0 || ret == -EIO);
     return ret;
 }
@@ -44,6 +44,7 @@
 #include "crypto.h"
 #include "block/aio_task.h"
 #include "block/dirty-bitmap.h"
+#include "block/thread-pool.h"
 
 /*
   Differences with QCOW:
@@ -321,7 +322,7 @@ qcow2_read_extensions(BlockDriverState *bs, uint64_t start_offset,
             }
             s->crypto = qcrypto_block_open(s->crypto_opts, "encrypt.",
                                            qcow2_crypto_hdr_read_func,
-                                           bs, cflags, QCOW2_MAX_THREADS, errp);
+                                           bs, cflags, s->max_threads, errp);
             if (!s->crypto) {
                 return -EINVAL;
             }
@@ -1328,6 +1329,8 @@ qcow2_do_open(BlockDriverState *bs, QDict *options, int flags,
     uint64_t l1_vm_state_index;
     bool update_header = false;
 
+    s->max_threads = thread_pool_max_cpu_jobs();
+
     ret = bdrv_co_pread(bs->file, 0, sizeof(header), &header, 0);
     if (ret < 0) {
         error_setg_errno(errp, -ret, "Could not read qcow2 header");
@@ -1702,7 +1705,7 @@ qcow2_do_open(BlockDriverState *bs, QDict *options, int flags,
             }
             s->crypto = qcrypto_block_open(s->crypto_opts, "encrypt.",
                                            NULL, NULL, cflags,
-                                           QCOW2_MAX_THREADS, errp);
+                                           s->max_threads, errp);
             if (!s->crypto) {
                 ret = -EINVAL;
                 goto fail;
@@ -5313,6 +5316,21 @@ qcow2_get_specific_info(BlockDriverState *bs, Error **errp)
     return spec_info;
 }
 
+static BlockStatsSpecific *qcow2_get_specific_stats(BlockDriverState *bs)
+{
+    BlockStatsSpecific *stats = g_new0(BlockStatsSpecific, 1);
+    BDRVQcow2State *s = bs->opaque;
+
+    stats->driver = BLOCKDEV_DRIVER_QCOW2;
+    stats->u.qcow2.l2_cache = g_new0(Qcow2CacheStats, 1);
+    stats->u.qcow2.refcount_cache = g_new0(Qcow2CacheStats, 1);
+    qcow2_cache_get_stats(s->l2_table_cache, stats->u.qcow2.l2_cache);
+    qcow2_cache_get_stats(s->refcount_block_cache,
+                          stats->u.qcow2.refcount_cache);
+
+    return stats;
+}
+
 static int coroutine_mixed_fn GRAPH_RDLOCK
 qcow2_has_zero_init(BlockDriverState *bs)
 {
@@ -6162,6 +6180,7 @@ BlockDriver bdrv_qcow2 = {
     .bdrv_measure                       = qcow2_measure,
     .bdrv_co_get_info                   = qcow2_co_get_info,
     .bdrv_get_specific_info             = qcow2_get_specific_info,
+    .bdrv_get_specific_stats            = qcow2_get_specific_stats,
 
     .bdrv_co_save_vmstate               = qcow2_co_save_vmstate,
     .bdrv_co_load_vmstate               = qcow2_co_load_vmstate,
@@ -322,8 +322,6 @@ typedef struct Qcow2BitmapHeaderExt {
     uint64_t bitmap_directory_offset;
 } QEMU_PACKED Qcow2BitmapHeaderExt;
 
-#define QCOW2_MAX_THREADS 4
-
 typedef struct BDRVQcow2State {
     int cluster_bits;
     int cluster_size;
@@ -410,6 +408,8 @@ typedef struct BDRVQcow2State {
 
     CoQueue thread_task_queue;
     int nb_threads;
+    /* Limit for concurrent compression, decompression and encryption jobs */
+    int max_threads;
 
     BdrvChild *data_file;
 
@@ -1021,6 +1021,7 @@ qcow2_cache_get_empty(BlockDriverState *bs, Qcow2Cache *c, uint64_t offset,
 void qcow2_cache_put(Qcow2Cache *c, void **table);
 void *qcow2_cache_is_table_offset(Qcow2Cache *c, uint64_t offset);
 void qcow2_cache_discard(Qcow2Cache *c, void *table);
+void qcow2_cache_get_stats(Qcow2Cache *c, Qcow2CacheStats *stats);
 
 /* qcow2-bitmap.c functions */
 int coroutine_fn GRAPH_RDLOCK
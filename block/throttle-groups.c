@@ -77,6 +77,12 @@ struct ThrottleGroup {
     bool any_timer_armed[THROTTLE_MAX];
     QEMUClockType clock_type;
 
+    /*
+     * Whether any limit applies to a direction.  Written under the lock,
+     * read without it by throttle_group_co_io_limits_intercept().
+     */
+    bool limited[THROTTLE_MAX];
+
     /* This field is protected by the global QEMU mutex */
     QTAILQ_ENTRY(ThrottleGroup) list;
 };
@@ -86,6 +92,20 @@ static QTAILQ_HEAD(, ThrottleGroup) throttle_groups =
     QTAILQ_HEAD_INITIALIZER(throttle_groups);
 
 
+/* Apply a new configuration to a group.  Must be called with tg->lock held
+ * once the group has been initialized.
+ */
+static void throttle_group_set_config(ThrottleGroup *tg, ThrottleConfig *cfg)
+{
+    ThrottleDirection dir;
+
+    throttle_config(&tg->ts, tg->clock_type, cfg);
+    for (dir = THROTTLE_READ; dir < THROTTLE_MAX; dir++) {
+        qatomic_set(&tg->limited[dir],
+                    throttle_direction_enabled(&tg->ts.cfg, dir));
+    }
+}
+
 /* This function reads throttle_groups and must be called under the global
  * mutex.
  */
@@ -369,6 +389,15 @@ void coroutine_fn throttle_group_co_io_limits_intercept(ThrottleGroupMember *tgm
     assert(bytes >= 0);
     assert(direction < THROTTLE_MAX);
 
+    /*
+     * Without any limit for this direction, requests never wait and their
+     * accounting is never looked at (throttle_config() resets the buckets
+     * when limits are added), so don't touch the group lock at all.
+     */
+    if (!qatomic_read(&tg->limited[direction])) {
+        return;
+    }
+
     qemu_mutex_lock(&tg->lock);
 
     /* First we check if this I/O has to be throttled. */
@@ -477,7 +506,7 @@ void throttle_group_config(ThrottleGroupMember *tgm, ThrottleConfig *cfg)
     ThrottleState *ts = tgm->throttle_state;
     ThrottleGroup *tg = container_of(ts, ThrottleGroup, ts);
     qemu_mutex_lock(&tg->lock);
-    throttle_config(ts, tg->clock_type, cfg);
+    throttle_group_set_config(tg, cfg);
     qemu_mutex_unlock(&tg->lock);
 
     throttle_group_restart_tgm(tgm);
@@ -791,7 +820,7 @@ static void throttle_group_obj_complete(UserCreatable *obj, Error **errp)
     if (!throttle_is_valid(&cfg, errp)) {
         return;
     }
-    throttle_config(&tg->ts, tg->clock_type, &cfg);
+    throttle_group_set_config(tg, &cfg);
     QTAILQ_INSERT_TAIL(&throttle_groups, tg, list);
     tg->is_initialized = true;
 }
@@ -902,7 +931,7 @@ static void throttle_group_set_limits(Object *obj, Visitor *v,
     if (local_err) {
         goto unlock;
     }
-    throttle_config(&tg->ts, tg->clock_type, &cfg);
+    throttle_group_set_config(tg, &cfg);
 
 unlock:
     qemu_mutex_unlock(&tg->lock);
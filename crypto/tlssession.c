@@ -240,12 +240,6 @@ qcrypto_tls_session_new(QCryptoTLSCreds *creds,
         goto error;
     }
 
-    gnutls_transport_set_ptr(session->handle, session);
-    gnutls_transport_set_push_function(session->handle,
-                                       qcrypto_tls_session_push);
-    gnutls_transport_set_pull_function(session->handle,
-                                       qcrypto_tls_session_pull);
-
     return session;
 
  error:
@@ -435,6 +429,43 @@ qcrypto_tls_session_set_callbacks(QCryptoTLSSession *session,
     session->writeFunc = writeFunc;
     session->readFunc = readFunc;
     session->opaque = opaque;
+
+    gnutls_transport_set_ptr(session->handle, session);
+    gnutls_transport_set_push_function(session->handle,
+                                       qcrypto_tls_session_push);
+    gnutls_transport_set_pull_function(session->handle,
+                                       qcrypto_tls_session_pull);
+}
+
+
+int
+qcrypto_tls_session_set_transport_fd(QCryptoTLSSession *session,
+                                     int fd,
+                                     Error **errp)
+{
+#ifdef HAVE_GNUTLS_KTLS
+    /*
+     * GNUTLS only considers kTLS when it owns the socket, i.e. no
+     * custom push/pull functions have been installed on the session.
+     */
+    gnutls_transport_set_int(session->handle, fd);
+    return 0;
+#else
+    error_setg(errp, "Kernel TLS offload not supported by this GNUTLS");
+    return -1;
+#endif
+}
+
+
+bool
+qcrypto_tls_session_has_ktls_send(QCryptoTLSSession *session)
+{
+#ifdef HAVE_GNUTLS_KTLS
+    return gnutls_transport_is_ktls_enabled(session->handle) &
+        GNUTLS_KTLS_SEND;
+#else
+    return false;
+#endif
 }
 
 
@@ -602,6 +633,23 @@ qcrypto_tls_session_set_callbacks(
 }
 
 
+int
+qcrypto_tls_session_set_transport_fd(QCryptoTLSSession *sess G_GNUC_UNUSED,
+                                     int fd G_GNUC_UNUSED,
+                                     Error **errp)
+{
+    error_setg(errp, "TLS requires GNUTLS support");
+    return -1;
+}
+
+
+bool
+qcrypto_tls_session_has_ktls_send(QCryptoTLSSession *sess G_GNUC_UNUSED)
+{
+    return false;
+}
+
+
 ssize_t
 qcrypto_tls_session_write(QCryptoTLSSession *sess,
                           const char *buf,
@@ -4704,10 +4704,10 @@ static void nvme_set_blk_stats(NvmeNamespace *ns, struct nvme_stats *stats)
 {
     BlockAcctStats *s = blk_get_stats(ns->blkconf.blk);
 
-    stats->units_read += s->nr_bytes[BLOCK_ACCT_READ];
-    stats->units_written += s->nr_bytes[BLOCK_ACCT_WRITE];
-    stats->read_commands += s->nr_ops[BLOCK_ACCT_READ];
-    stats->write_commands += s->nr_ops[BLOCK_ACCT_WRITE];
+    stats->units_read += stat64_get(&s->nr_bytes[BLOCK_ACCT_READ]);
+    stats->units_written += stat64_get(&s->nr_bytes[BLOCK_ACCT_WRITE]);
+    stats->read_commands += stat64_get(&s->nr_ops[BLOCK_ACCT_READ]);
+    stats->write_commands += stat64_get(&s->nr_ops[BLOCK_ACCT_WRITE]);
 }
 
 static uint16_t nvme_smart_info(NvmeCtrl *n, uint8_t rae, uint32_t buf_len,
@@ -407,7 +407,8 @@ static void mptsas_process_scsi_task_mgmt(MPTSASState *s, MPIMsgSCSITaskMgmt *re
     MPIMsgSCSITaskMgmtReply *reply_async;
     int status, count;
     SCSIDevice *sdev;
-    SCSIRequest *r, *next;
+    SCSIRequest *r = NULL;
+    GList *reqs, *elem;
     BusChild *kid;
 
     mptsas_fix_scsi_task_mgmt_endianness(req);
@@ -438,9 +439,11 @@ static void mptsas_process_scsi_task_mgmt(MPTSASState *s, MPIMsgSCSITaskMgmt *re
             goto out;
         }
 
-        QTAILQ_FOREACH_SAFE(r, &sdev->requests, next, next) {
-            MPTSASRequest *cmd_req = r->hba_private;
+        reqs = scsi_device_get_requests(sdev);
+        for (elem = reqs; elem; elem = elem->next) {
+            MPTSASRequest *cmd_req = ((SCSIRequest *)elem->data)->hba_private;
             if (cmd_req && cmd_req->scsi_io.MsgContext == req->TaskMsgContext) {
+                r = elem->data;
                 break;
             }
         }
@@ -467,9 +470,11 @@ static void mptsas_process_scsi_task_mgmt(MPTSASState *s, MPIMsgSCSITaskMgmt *re
                 notifier->reply = reply_async;
                 notifier->notifier.notify = mptsas_cancel_notify;
                 scsi_req_cancel_async(r, &notifier->notifier);
+                scsi_device_put_requests(reqs);
                 goto reply_maybe_async;
             }
         }
+        scsi_device_put_requests(reqs);
         break;
 
     case MPI_SCSITASKMGMT_TASKTYPE_ABRT_TASK_SET:
@@ -489,7 +494,9 @@ static void mptsas_process_scsi_task_mgmt(MPTSASState *s, MPIMsgSCSITaskMgmt *re
         reply_async->IOCLogInfo = INT_MAX;
 
         count = 0;
-        QTAILQ_FOREACH_SAFE(r, &sdev->requests, next, next) {
+        reqs = scsi_device_get_requests(sdev);
+        for (elem = reqs; elem; elem = elem->next) {
+            r = elem->data;
             if (r->hba_private) {
                 MPTSASCancelNotifier *notifier;
 
@@ -501,6 +508,7 @@ static void mptsas_process_scsi_task_mgmt(MPTSASState *s, MPIMsgSCSITaskMgmt *re
                 scsi_req_cancel_async(r, &notifier->notifier);
             }
         }
+        scsi_device_put_requests(reqs);
 
 reply_maybe_async:
         if (reply_async->TerminationCount < count) {
@@ -100,13 +100,17 @@ static void scsi_device_for_each_req_sync(SCSIDevice *s,
     assert(!runstate_is_running());
     assert(qemu_in_main_thread());
 
-    QTAILQ_FOREACH_SAFE(req, &s->requests, next, next_req) {
-        fn(req, opaque);
+    /* @fn() only serializes requests, it does not dequeue them */
+    WITH_QEMU_LOCK_GUARD(&s->requests_lock) {
+        QTAILQ_FOREACH_SAFE(req, &s->requests, next, next_req) {
+            fn(req, opaque);
+        }
     }
 }
 
 typedef struct {
     SCSIDevice *s;
+    AioContext *ctx;
     void (*fn)(SCSIRequest *, void *);
     void *fn_opaque;
 } SCSIDeviceForEachReqAsyncData;
@@ -115,21 +119,30 @@ static void scsi_device_for_each_req_async_bh(void *opaque)
 {
     g_autofree SCSIDeviceForEachReqAsyncData *data = opaque;
     SCSIDevice *s = data->s;
-    AioContext *ctx;
+    g_autoptr(GList) reqs = NULL;
+    GList *elem;
     SCSIRequest *req;
-    SCSIRequest *next;
+
+    assert(data->ctx == qemu_get_current_aio_context());
 
     /*
-     * The BB cannot have changed contexts between this BH being scheduled and
-     * now: BBs' AioContexts, when they have a node attached, can only be
-     * changed via bdrv_try_change_aio_context(), in a drained section.  While
-     * we have the in-flight counter incremented, that drain must block.
+     * Take a reference to each request owned by this AioContext so that @fn()
+     * can be called without holding requests_lock: @fn() may complete or
+     * cancel the request, which dequeues it.
      */
-    ctx = blk_get_aio_context(s->conf.blk);
-    assert(ctx == qemu_get_current_aio_context());
+    WITH_QEMU_LOCK_GUARD(&s->requests_lock) {
+        QTAILQ_FOREACH(req, &s->requests, next) {
+            if (req->ctx == data->ctx) {
+                scsi_req_ref(req);
+                reqs = g_list_prepend(reqs, req);
+            }
+        }
+    }
 
-    QTAILQ_FOREACH_SAFE(req, &s->requests, next, next) {
+    for (elem = g_list_last(reqs); elem; elem = elem->prev) {
+        req = elem->data;
         data->fn(req, data->fn_opaque);
+        scsi_req_unref(req);
     }
 
     /* Drop the reference taken by scsi_device_for_each_req_async() */
@@ -139,22 +152,17 @@ static void scsi_device_for_each_req_async_bh(void *opaque)
     blk_dec_in_flight(s->conf.blk);
 }
 
-/*
- * Schedule @fn() to be invoked for each enqueued request in device @s. @fn()
- * runs in the AioContext that is executing the request.
- * Keeps the BlockBackend's in-flight counter incremented until everything is
- * done, so draining it will settle all scheduled @fn() calls.
- */
-static void scsi_device_for_each_req_async(SCSIDevice *s,
-                                           void (*fn)(SCSIRequest *, void *),
-                                           void *opaque)
+static void scsi_device_for_each_req_async_schedule(SCSIDevice *s,
+                                                    AioContext *ctx,
+                                                    void (*fn)(SCSIRequest *,
+                                                               void *),
+                                                    void *opaque)
 {
-    assert(qemu_in_main_thread());
-
     SCSIDeviceForEachReqAsyncData *data =
         g_new(SCSIDeviceForEachReqAsyncData, 1);
 
     data->s = s;
+    data->ctx = ctx;
     data->fn = fn;
     data->fn_opaque = opaque;
 
@@ -166,9 +174,72 @@ static void scsi_device_for_each_req_async(SCSIDevice *s,
 
     /* Paired with blk_dec_in_flight() in scsi_device_for_each_req_async_bh() */
     blk_inc_in_flight(s->conf.blk);
-    aio_bh_schedule_oneshot(blk_get_aio_context(s->conf.blk),
-                            scsi_device_for_each_req_async_bh,
-                            data);
+    aio_bh_schedule_oneshot(ctx, scsi_device_for_each_req_async_bh, data);
+}
+
+/*
+ * Schedule @fn() to be invoked for each enqueued request in device @s. @fn()
+ * runs in the AioContext that is executing the request.
+ * Keeps the BlockBackend's in-flight counter incremented until everything is
+ * done, so draining it will settle all scheduled @fn() calls.
+ */
+static void scsi_device_for_each_req_async(SCSIDevice *s,
+                                           void (*fn)(SCSIRequest *, void *),
+                                           void *opaque)
+{
+    g_autoptr(GHashTable) ctxs = g_hash_table_new(NULL, NULL);
+    GHashTableIter iter;
+    gpointer key;
+    SCSIRequest *req;
+
+    assert(qemu_in_main_thread());
+
+    /*
+     * Requests may be spread over several AioContexts.  Schedule one BH in
+     * each of them; a request's AioContext never changes while it is
+     * enqueued, and requests submitted after this point are not visited.
+     */
+    WITH_QEMU_LOCK_GUARD(&s->requests_lock) {
+        QTAILQ_FOREACH(req, &s->requests, next) {
+            g_hash_table_add(ctxs, req->ctx);
+        }
+    }
+
+    /*
+     * Also visit the BlockBackend's AioContext unconditionally, so requests
+     * that are submitted there before the BH runs are not missed.
+     */
+    g_hash_table_add(ctxs, blk_get_aio_context(s->conf.blk));
+
+    g_hash_table_iter_init(&iter, ctxs);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        scsi_device_for_each_req_async_schedule(s, key, fn, opaque);
+    }
+}
+
+/*
+ * Return the requests enqueued in device @s, oldest first, with a reference
+ * taken to each of them.  Callers can then look at or cancel the requests
+ * without holding requests_lock; cancelling a request dequeues it.  Release
+ * the list with scsi_device_put_requests().
+ */
+GList *scsi_device_get_requests(SCSIDevice *s)
+{
+    GList *reqs = NULL;
+    SCSIRequest *req;
+
+    WITH_QEMU_LOCK_GUARD(&s->requests_lock) {
+        QTAILQ_FOREACH_REVERSE(req, &s->requests, next) {
+            scsi_req_ref(req);
+            reqs = g_list_prepend(reqs, req);
+        }
+    }
+    return reqs;
+}
+
+void scsi_device_put_requests(GList *reqs)
+{
+    g_list_free_full(reqs, (GDestroyNotify)scsi_req_unref);
 }
 
 static void scsi_device_realize(SCSIDevice *s, Error **errp)
@@ -349,9 +420,11 @@ static void scsi_qdev_realize(DeviceState *qdev, Error **errp)
         dev->lun = lun;
     }
 
+    qemu_mutex_init(&dev->requests_lock);
     QTAILQ_INIT(&dev->requests);
     scsi_device_realize(dev, &local_err);
     if (local_err) {
+        qemu_mutex_destroy(&dev->requests_lock);
         error_propagate(errp, local_err);
         return;
     }
@@ -372,6 +445,8 @@ static void scsi_qdev_unrealize(DeviceState *qdev)
     scsi_device_unrealize(dev);
 
     blockdev_mark_auto_del(dev->conf.blk);
+
+    qemu_mutex_destroy(&dev->requests_lock);
 }
 
 /* handle legacy '-drive if=scsi,...' cmd line args */
@@ -777,6 +852,7 @@ SCSIRequest *scsi_req_alloc(const SCSIReqOps *reqops, SCSIDevice *d,
     req->refcount = 1;
     req->bus = bus;
     req->dev = d;
+    req->ctx = qemu_get_current_aio_context();
     req->tag = tag;
     req->lun = lun;
     req->hba_private = hba_private;
@@ -955,7 +1031,10 @@ static void scsi_req_enqueue_internal(SCSIRequest *req)
         req->sg = NULL;
     }
     req->enqueued = true;
-    QTAILQ_INSERT_TAIL(&req->dev->requests, req, next);
+
+    WITH_QEMU_LOCK_GUARD(&req->dev->requests_lock) {
+        QTAILQ_INSERT_TAIL(&req->dev->requests, req, next);
+    }
 }
 
 int32_t scsi_req_enqueue(SCSIRequest *req)
@@ -975,7 +1054,9 @@ static void scsi_req_dequeue(SCSIRequest *req)
     trace_scsi_req_dequeue(req->dev->id, req->lun, req->tag);
     req->retry = false;
     if (req->enqueued) {
-        QTAILQ_REMOVE(&req->dev->requests, req, next);
+        WITH_QEMU_LOCK_GUARD(&req->dev->requests_lock) {
+            QTAILQ_REMOVE(&req->dev->requests, req, next);
+        }
         req->enqueued = false;
         scsi_req_unref(req);
     }
@@ -1433,17 +1514,22 @@ void scsi_device_report_change(SCSIDevice *dev, SCSISense sense)
     }
 }
 
+/*
+ * References are taken and dropped from several threads: by the AioContext
+ * that runs the request and by threads that look at or cancel a device's
+ * requests, e.g. the main loop through scsi_device_get_requests().
+ */
 SCSIRequest *scsi_req_ref(SCSIRequest *req)
 {
-    assert(req->refcount > 0);
-    req->refcount++;
+    assert(qatomic_read(&req->refcount) > 0);
+    qatomic_inc(&req->refcount);
     return req;
 }
 
 void scsi_req_unref(SCSIRequest *req)
 {
-    assert(req->refcount > 0);
-    if (--req->refcount == 0) {
+    assert(qatomic_read(&req->refcount) > 0);
+    if (qatomic_fetch_dec(&req->refcount) == 1) {
         BusState *qbus = req->dev->qdev.parent_bus;
         SCSIBus *bus = DO_UPCAST(SCSIBus, qbus, qbus);
 
@@ -1858,6 +1944,11 @@ static int get_scsi_requests(QEMUFile *f, void *pv, size_t size,
          * SCSI_CMD_BUF_SIZE as the CDB length.
          */
         req = scsi_req_new(s, tag, lun, buf, sizeof(buf), NULL);
+        /*
+         * scsi_req_new() bound the request to the main loop, but it will be
+         * restarted in the AioContext that processes the device's requests.
+         */
+        req->ctx = blk_get_aio_context(s->conf.blk);
         req->retry = (sbyte == 1);
         if (bus->info->load_request) {
             req->hba_private = bus->info->load_request(f, req);
@@ -1776,7 +1776,8 @@ static gboolean backend_read(QIOChannel *ioc, GIOCondition condition,
     iov.iov_base = &hdr;
     iov.iov_len = VHOST_USER_HDR_SIZE;
 
-    if (qio_channel_readv_full_all(ioc, &iov, 1, &fd, &fdsize, &local_err)) {
+    if (qio_channel_readv_full_all(ioc, &iov, 1, &fd, &fdsize, 0,
+                                   &local_err)) {
         error_report_err(local_err);
         goto err;
     }
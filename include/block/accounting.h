@@ -27,6 +27,7 @@
 
 #include "qemu/timed-average.h"
 #include "qemu/thread.h"
+#include "qemu/stats64.h"
 #include "qapi/qapi-types-common.h"
 
 typedef struct BlockAcctTimedStats BlockAcctTimedStats;
@@ -80,14 +81,18 @@ typedef struct BlockLatencyHistogram {
 } BlockLatencyHistogram;
 
 struct BlockAcctStats {
+    /*
+     * The counters are updated atomically from whichever thread completes
+     * the request; @lock only protects @intervals and the histograms.
+     */
     QemuMutex lock;
-    uint64_t nr_bytes[BLOCK_MAX_IOTYPE];
-    uint64_t nr_ops[BLOCK_MAX_IOTYPE];
-    uint64_t invalid_ops[BLOCK_MAX_IOTYPE];
-    uint64_t failed_ops[BLOCK_MAX_IOTYPE];
-    uint64_t total_time_ns[BLOCK_MAX_IOTYPE];
-    uint64_t merged[BLOCK_MAX_IOTYPE];
-    int64_t last_access_time_ns;
+    Stat64 nr_bytes[BLOCK_MAX_IOTYPE];
+    Stat64 nr_ops[BLOCK_MAX_IOTYPE];
+    Stat64 invalid_ops[BLOCK_MAX_IOTYPE];
+    Stat64 failed_ops[BLOCK_MAX_IOTYPE];
+    Stat64 total_time_ns[BLOCK_MAX_IOTYPE];
+    Stat64 merged[BLOCK_MAX_IOTYPE];
+    Stat64 last_access_time_ns;
     QSLIST_HEAD(, BlockAcctTimedStats) intervals;
     bool account_invalid;
     bool account_failed;
@@ -98,4 +98,12 @@ BdrvDirtyBitmap *block_copy_dirty_bitmap(BlockCopyState *s);
 int64_t block_copy_cluster_size(BlockCopyState *s);
 void block_copy_set_skip_unallocated(BlockCopyState *s, bool skip);
 
+/*
+ * Account a buffered copy task of @bytes that took @ns to complete, as done
+ * for every such task, and return the chunk size for the next ones.  This
+ * allows testing the chunk size adaptation with given timings.
+ */
+int64_t coroutine_fn block_copy_adapt_buffer_size(BlockCopyState *s,
+                                                  int64_t bytes, int64_t ns);
+
 #endif /* BLOCK_COPY_H */
@@ -73,6 +73,17 @@ int coroutine_fn luring_co_submit(BlockDriverState *bs, int fd, uint64_t offset,
                                   QEMUIOVector *qiov, int type);
 void luring_detach_aio_context(LuringState *s, AioContext *old_context);
 void luring_attach_aio_context(LuringState *s, AioContext *new_context);
+
+/*
+ * Registered files and fixed buffers, shared by the rings of all AioContexts.
+ * A registered file keeps the file open, so luring_unregister_fd() must be
+ * called before closing @fd.  Both must be called without requests on @fd
+ * in flight.
+ */
+void luring_register_fd(int fd);
+void luring_unregister_fd(int fd);
+bool luring_register_buf(void *host, size_t size, Error **errp);
+void luring_unregister_buf(void *host, size_t size);
 #endif
 
 #ifdef _WIN32
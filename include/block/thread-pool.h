@@ -38,6 +38,12 @@ BlockAIOCB *thread_pool_submit_aio(ThreadPoolFunc *func, void *arg,
 int coroutine_fn thread_pool_submit_co(ThreadPoolFunc *func, void *arg);
 void thread_pool_submit(ThreadPoolFunc *func, void *arg);
 
+/*
+ * Number of CPU-bound jobs worth running in parallel in the thread pool: one
+ * per host CPU, at least 4 and at most THREAD_POOL_MAX_THREADS_DEFAULT.
+ */
+int thread_pool_max_cpu_jobs(void);
+
 void thread_pool_update_params(ThreadPool *pool, struct AioContext *ctx);
 
 #endif
@@ -207,6 +207,48 @@ void qcrypto_tls_session_set_callbacks(QCryptoTLSSession *sess,
                                        QCryptoTLSSessionReadFunc readFunc,
                                        void *opaque);
 
+/**
+ * qcrypto_tls_session_set_transport_fd:
+ * @sess: the TLS session object
+ * @fd: the connected socket file descriptor
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Use @fd directly as the underlying data channel, as an
+ * alternative to qcrypto_tls_session_set_callbacks(). This
+ * allows the TLS library to hand the record layer over to
+ * the kernel (kTLS) once the handshake has completed, if
+ * both the host kernel and the TLS library configuration
+ * permit it.
+ *
+ * This must be called before the handshake is started.
+ * If kernel TLS offload cannot be supported by this build
+ * an error is reported, and the caller should fall back to
+ * qcrypto_tls_session_set_callbacks().
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int qcrypto_tls_session_set_transport_fd(QCryptoTLSSession *sess,
+                                         int fd,
+                                         Error **errp);
+
+/**
+ * qcrypto_tls_session_has_ktls_send:
+ * @sess: the TLS session object
+ *
+ * Check whether the kernel is encrypting outgoing records
+ * for the session. When this returns true, plain text
+ * written directly to the socket passed to
+ * qcrypto_tls_session_set_transport_fd() is sent as TLS
+ * records, without going through qcrypto_tls_session_write().
+ *
+ * It is an error to call this before
+ * qcrypto_tls_session_get_handshake_status() returns
+ * QCRYPTO_TLS_HANDSHAKE_COMPLETE
+ *
+ * Returns: true if kernel TLS offload is active for sending
+ */
+bool qcrypto_tls_session_has_ktls_send(QCryptoTLSSession *sess);
+
 /**
  * qcrypto_tls_session_write:
  * @sess: the TLS session object
@@ -23,6 +23,7 @@ typedef struct SCSIReqOps SCSIReqOps;
 struct SCSIRequest {
     SCSIBus           *bus;
     SCSIDevice        *dev;
+    AioContext        *ctx;
     const SCSIReqOps  *ops;
     uint32_t          refcount;
     uint32_t          tag;
@@ -77,9 +78,12 @@ struct SCSIDevice
     uint32_t sense_len;
 
     /*
-     * The requests list is only accessed from the AioContext that executes
-     * requests or from the main loop when IOThread processing is stopped.
+     * Requests may be executed in more than one AioContext (see
+     * SCSIRequest->ctx), so requests_lock protects the list.  It is never
+     * held while calling back into a request; HBAs that need to walk the
+     * list use scsi_device_get_requests().
      */
+    QemuMutex requests_lock;
     QTAILQ_HEAD(, SCSIRequest) requests;
 
     uint32_t channel;
@@ -231,6 +235,8 @@ void scsi_req_retry(SCSIRequest *req);
 void scsi_device_drained_begin(SCSIDevice *sdev);
 void scsi_device_drained_end(SCSIDevice *sdev);
 void scsi_device_purge_requests(SCSIDevice *sdev, SCSISense sense);
+GList *scsi_device_get_requests(SCSIDevice *sdev);
+void scsi_device_put_requests(GList *reqs);
 void scsi_device_set_ua(SCSIDevice *sdev, SCSISense sense);
 void scsi_device_report_change(SCSIDevice *dev, SCSISense sense);
 void scsi_device_unit_attention_reported(SCSIDevice *dev);
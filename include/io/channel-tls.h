@@ -49,6 +49,8 @@ struct QIOChannelTLS {
     QCryptoTLSSession *session;
     QIOChannelShutdown shutdown;
     guint hs_ioc_tag;
+    bool ktls;
+    bool ktls_send;
 };
 
 /**
@@ -111,6 +113,23 @@ qio_channel_tls_new_client(QIOChannel *master,
                            const char *hostname,
                            Error **errp);
 
+/**
+ * qio_channel_tls_enable_ktls:
+ * @ioc: the TLS channel object
+ *
+ * Request kernel TLS offload for the channel. If the
+ * master channel is a socket and the TLS library supports
+ * it, the library is given the socket file descriptor
+ * instead of using the master channel's I/O functions, so
+ * that it can hand record encryption to the kernel once
+ * the handshake has completed. Otherwise, or if the kernel
+ * lacks TLS support, the channel works as if this had not
+ * been called.
+ *
+ * This must be called before qio_channel_tls_handshake().
+ */
+void qio_channel_tls_enable_ktls(QIOChannelTLS *ioc);
+
 /**
  * qio_channel_tls_handshake:
  * @ioc: the TLS channel object
@@ -35,6 +35,7 @@ OBJECT_DECLARE_TYPE(QIOChannel, QIOChannelClass,
 #define QIO_CHANNEL_WRITE_FLAG_ZERO_COPY 0x1
 
 #define QIO_CHANNEL_READ_FLAG_MSG_PEEK 0x1
+#define QIO_CHANNEL_READ_FLAG_WAITALL 0x2
 
 typedef enum QIOChannelFeature QIOChannelFeature;
 
@@ -882,6 +883,7 @@ void qio_channel_set_aio_fd_handler(QIOChannel *ioc,
  * @niov: the length of the @iov array
  * @fds: an array of file handles to read
  * @nfds: number of file handles in @fds
+ * @flags: read flags (QIO_CHANNEL_READ_FLAG_*)
  * @errp: pointer to a NULL-initialized error object
  *
  *
@@ -892,6 +894,12 @@ void qio_channel_set_aio_fd_handler(QIOChannel *ioc,
  * coroutine if required. data refers to both file
  * descriptors and the iovs.
  *
+ * If QIO_CHANNEL_READ_FLAG_WAITALL is passed in @flags,
+ * channels that support it will try to fill all of @iov
+ * in a single read rather than returning as soon as any
+ * data is available. This is only a hint and has no effect
+ * on channels without such support.
+ *
  * Returns: 1 if all bytes were read, 0 if end-of-file
  *          occurs without data, or -1 on error
  */
@@ -900,7 +908,7 @@ int coroutine_mixed_fn qio_channel_readv_full_all_eof(QIOChannel *ioc,
                                                       const struct iovec *iov,
                                                       size_t niov,
                                                       int **fds, size_t *nfds,
-                                                      Error **errp);
+                                                      int flags, Error **errp);
 
 /**
  * qio_channel_readv_full_all:
@@ -909,6 +917,7 @@ int coroutine_mixed_fn qio_channel_readv_full_all_eof(QIOChannel *ioc,
  * @niov: the length of the @iov array
  * @fds: an array of file handles to read
  * @nfds: number of file handles in @fds
+ * @flags: read flags (QIO_CHANNEL_READ_FLAG_*)
  * @errp: pointer to a NULL-initialized error object
  *
  *
@@ -926,7 +935,7 @@ int coroutine_mixed_fn qio_channel_readv_full_all(QIOChannel *ioc,
                                                   const struct iovec *iov,
                                                   size_t niov,
                                                   int **fds, size_t *nfds,
-                                                  Error **errp);
+                                                  int flags, Error **errp);
 
 /**
  * qio_channel_writev_full_all:
@@ -141,6 +141,9 @@ bool throttle_timers_are_initialized(ThrottleTimers *tt);
 /* configuration */
 bool throttle_enabled(ThrottleConfig *cfg);
 
+bool throttle_direction_enabled(ThrottleConfig *cfg,
+                                ThrottleDirection direction);
+
 bool throttle_is_valid(ThrottleConfig *cfg, Error **errp);
 
 void throttle_config(ThrottleState *ts,
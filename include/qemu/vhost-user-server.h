@@ -24,6 +24,8 @@ typedef struct VuFdWatch {
     int fd; /*kick fd*/
     void *pvt;
     vu_watch_cb cb;
+    AioContext *vq_ctx; /* AioContext for this virtqueue, or NULL */
+    AioContext *ctx; /* AioContext the fd handler is registered in, or NULL */
     QTAILQ_ENTRY(VuFdWatch) next;
 } VuFdWatch;
 
@@ -31,7 +33,9 @@ typedef struct VuFdWatch {
  * VuServer:
  * A vhost-user server instance with user-defined VuDevIface callbacks.
  * Vhost-user device backends can be implemented using VuServer. VuDevIface
- * callbacks and virtqueue kicks run in the given AioContext.
+ * callbacks and virtqueue kicks run in the given AioContext, unless
+ * per-virtqueue AioContexts are given, in which case kicks for virtqueue n
+ * run in vq_ctxs[n % nr_vq_ctxs].
  */
 typedef struct {
     QIONetListener *listener;
@@ -39,13 +43,16 @@ typedef struct {
     AioContext *ctx;
     int max_queues;
     const VuDevIface *vu_iface;
+    AioContext **vq_ctxs;
+    unsigned int nr_vq_ctxs;
 
     unsigned int in_flight; /* atomic */
+    Coroutine *idle_co; /* atomic, woken when in_flight drops to zero */
 
     /* Protected by ctx lock */
     bool in_qio_channel_yield;
-    bool wait_idle;
     bool quiescing;
+    bool vqs_paused; /* kick fds are not monitored while handling a message */
     VuDev vu_dev;
     QIOChannel *ioc; /* The I/O channel with the client */
     QIOChannelSocket *sioc; /* The underlying data channel with the client */
@@ -58,6 +65,8 @@ bool vhost_user_server_start(VuServer *server,
                              SocketAddress *unix_socket,
                              AioContext *ctx,
                              uint16_t max_queues,
+                             AioContext **vq_ctxs,
+                             unsigned int nr_vq_ctxs,
                              const VuDevIface *vu_iface,
                              Error **errp);
 
@@ -22,6 +22,7 @@
 #include "qapi/error.h"
 #include "qemu/module.h"
 #include "io/channel-tls.h"
+#include "io/channel-socket.h"
 #include "trace.h"
 #include "qemu/atomic.h"
 
@@ -63,6 +64,31 @@ static ssize_t qio_channel_tls_read_handler(char *buf,
 }
 
 
+static void qio_channel_tls_set_transport(QIOChannelTLS *tioc)
+{
+    QIOChannelSocket *sioc = (QIOChannelSocket *)
+        object_dynamic_cast(OBJECT(tioc->master), TYPE_QIO_CHANNEL_SOCKET);
+
+    /*
+     * If the caller asked for it, let GNUTLS drive the socket
+     * directly so that it can enable kernel TLS offload after
+     * the handshake. Other master channels, or builds without
+     * kTLS support, keep using the read/write callbacks.
+     */
+    if (tioc->ktls && sioc &&
+        qcrypto_tls_session_set_transport_fd(tioc->session,
+                                             sioc->fd, NULL) == 0) {
+        return;
+    }
+
+    qcrypto_tls_session_set_callbacks(
+        tioc->session,
+        qio_channel_tls_write_handler,
+        qio_channel_tls_read_handler,
+        tioc);
+}
+
+
 QIOChannelTLS *
 qio_channel_tls_new_server(QIOChannel *master,
                            QCryptoTLSCreds *creds,
@@ -89,12 +115,6 @@ qio_channel_tls_new_server(QIOChannel *master,
         goto error;
     }
 
-    qcrypto_tls_session_set_callbacks(
-        ioc->session,
-        qio_channel_tls_write_handler,
-        qio_channel_tls_read_handler,
-        ioc);
-
     trace_qio_channel_tls_new_server(ioc, master, creds, aclname);
     return ioc;
 
@@ -131,12 +151,6 @@ qio_channel_tls_new_client(QIOChannel *master,
         goto error;
     }
 
-    qcrypto_tls_session_set_callbacks(
-        tioc->session,
-        qio_channel_tls_write_handler,
-        qio_channel_tls_read_handler,
-        tioc);
-
     trace_qio_channel_tls_new_client(tioc, master, creds, hostname);
     return tioc;
 
@@ -145,6 +159,11 @@ qio_channel_tls_new_client(QIOChannel *master,
     return NULL;
 }
 
+void qio_channel_tls_enable_ktls(QIOChannelTLS *ioc)
+{
+    ioc->ktls = true;
+}
+
 struct QIOChannelTLSData {
     QIOTask *task;
     GMainContext *context;
@@ -178,6 +197,10 @@ static void qio_channel_tls_handshake_task(QIOChannelTLS *ioc,
             qio_task_set_error(task, err);
         } else {
             trace_qio_channel_tls_credentials_allow(ioc);
+            if (qcrypto_tls_session_has_ktls_send(ioc->session)) {
+                trace_qio_channel_tls_ktls_send(ioc);
+                ioc->ktls_send = true;
+            }
         }
         qio_task_complete(task);
     } else {
@@ -241,6 +264,9 @@ void qio_channel_tls_handshake(QIOChannelTLS *ioc,
     task = qio_task_new(OBJECT(ioc),
                         func, opaque, destroy);
 
+    /* Only now, because qio_channel_tls_enable_ktls() may change it */
+    qio_channel_tls_set_transport(ioc);
+
     trace_qio_channel_tls_handshake_start(ioc);
     qio_channel_tls_handshake_task(ioc, task, context);
 }
@@ -314,6 +340,15 @@ static ssize_t qio_channel_tls_writev(QIOChannel *ioc,
     size_t i;
     ssize_t done = 0;
 
+    if (tioc->ktls_send) {
+        /*
+         * The kernel builds the TLS records, so the whole vector
+         * can be handed to the socket in a single call.
+         */
+        return qio_channel_writev_full(tioc->master, iov, niov,
+                                       NULL, 0, flags, errp);
+    }
+
     for (i = 0 ; i < niov ; i++) {
         ssize_t ret = qcrypto_tls_session_write(tioc->session,
                                                 iov[i].iov_base,
@@ -50,10 +50,25 @@ void file_cleanup_outgoing_migration(void)
     outgoing_args.fname = NULL;
 }
 
+/*
+ * With mapped-ram, the multifd channels only read and write pages at
+ * aligned file offsets, so they can bypass the page cache. The main
+ * channel carries the unaligned rest of the stream and stays buffered.
+ */
+static int file_multifd_open_flags(int flags)
+{
+#ifdef O_DIRECT
+    if (migrate_direct_io()) {
+        flags |= O_DIRECT;
+    }
+#endif
+    return flags;
+}
+
 bool file_send_channel_create(gpointer opaque, Error **errp)
 {
     QIOChannelFile *ioc;
-    int flags = O_WRONLY;
+    int flags = file_multifd_open_flags(O_WRONLY);
     bool ret = true;
 
     ioc = qio_channel_file_new_path(outgoing_args.fname, flags, 0, errp);
@@ -109,7 +124,8 @@ static gboolean file_accept_incoming_migration(QIOChannel *ioc,
     return G_SOURCE_REMOVE;
 }
 
-void file_create_incoming_channels(QIOChannel *ioc, Error **errp)
+void file_create_incoming_channels(QIOChannel *ioc, char *filename,
+                                   Error **errp)
 {
     int i, fd, channels = 1;
     g_autofree QIOChannel **iocs = NULL;
@@ -123,7 +139,15 @@ void file_create_incoming_channels(QIOChannel *ioc, Error **errp)
     iocs[0] = ioc;
 
     for (i = 1; i < channels; i++) {
-        QIOChannelFile *fioc = qio_channel_file_new_dupfd(fd, errp);
+        QIOChannelFile *fioc;
+
+        if (migrate_direct_io()) {
+            /* O_DIRECT needs a file description of its own */
+            fioc = qio_channel_file_new_path(
+                filename, file_multifd_open_flags(O_RDONLY), 0, errp);
+        } else {
+            fioc = qio_channel_file_new_dupfd(fd, errp);
+        }
 
         if (!fioc) {
             while (i) {
@@ -163,7 +187,7 @@ void file_start_incoming_migration(FileMigrationArgs *file_args, Error **errp)
         return;
     }
 
-    file_create_incoming_channels(QIO_CHANNEL(fioc), errp);
+    file_create_incoming_channels(QIO_CHANNEL(fioc), filename, errp);
 }
 
 int file_write_ramblock_iov(QIOChannel *ioc, const struct iovec *iov,
@@ -278,7 +278,13 @@ static int nocomp_recv(MultiFDRecvParams *p, Error **errp)
         p->iov[i].iov_base = p->host + p->normal[i];
         p->iov[i].iov_len = p->page_size;
     }
-    return qio_channel_readv_all(p->c, p->iov, p->normal_num, errp);
+    /*
+     * The whole batch of pages is known to follow the packet, so ask
+     * the socket to fill it in one go instead of returning after each
+     * partial segment; this saves many recvmsg() calls per packet.
+     */
+    return qio_channel_readv_full_all(p->c, p->iov, p->normal_num, NULL, NULL,
+                                      QIO_CHANNEL_READ_FLAG_WAITALL, errp);
 }
 
 static MultiFDMethods multifd_nocomp_ops = {
@@ -87,6 +87,7 @@ void migration_tls_channel_process_incoming(MigrationState *s,
     if (!tioc) {
         return;
     }
+    qio_channel_tls_enable_ktls(tioc);
 
     trace_migration_tls_incoming_handshake_start();
     qio_channel_set_name(QIO_CHANNEL(tioc), "migration-tls-incoming");
@@ -119,6 +120,7 @@ QIOChannelTLS *migration_tls_client_create(QIOChannel *ioc,
                                            Error **errp)
 {
     QCryptoTLSCreds *creds;
+    QIOChannelTLS *tioc;
 
     creds = migration_tls_get_creds(QCRYPTO_TLS_CREDS_ENDPOINT_CLIENT, errp);
     if (!creds) {
@@ -130,7 +132,12 @@ QIOChannelTLS *migration_tls_client_create(QIOChannel *ioc,
         hostname = tls_hostname;
     }
 
-    return qio_channel_tls_new_client(ioc, creds, hostname, errp);
+    tioc = qio_channel_tls_new_client(ioc, creds, hostname, errp);
+    if (tioc) {
+        /* Bulk RAM transfer is where kernel TLS offload pays off */
+        qio_channel_tls_enable_ktls(tioc);
+    }
+    return tioc;
 }
 
 void migration_tls_channel_connect(MigrationState *s,
@@ -15,9 +15,92 @@
 #include "qemu/host-utils.h"
 #include "xbzrle.h"
 
-#if defined(CONFIG_AVX512BW_OPT)
+#if defined(CONFIG_AVX2_OPT) || defined(CONFIG_AVX512BW_OPT)
 #include <immintrin.h>
 #include "host/cpuinfo.h"
+#endif
+
+#if defined(CONFIG_AVX2_OPT)
+/*
+ * Return the index of the first byte at or after @i where @old_buf and
+ * @new_buf differ (@skip_same) or are equal (!@skip_same), or @slen
+ * if there is none.
+ */
+static inline int __attribute__((target("avx2")))
+xbzrle_skip_avx2(uint8_t *old_buf, uint8_t *new_buf, int i, int slen,
+                 bool skip_same)
+{
+    while (i + 32 <= slen) {
+        __m256i old_data = _mm256_loadu_si256((__m256i *)(old_buf + i));
+        __m256i new_data = _mm256_loadu_si256((__m256i *)(new_buf + i));
+        uint32_t same = _mm256_movemask_epi8(_mm256_cmpeq_epi8(old_data,
+                                                               new_data));
+        uint32_t stop = skip_same ? ~same : same;
+
+        if (stop) {
+            return i + ctz32(stop);
+        }
+        i += 32;
+    }
+
+    while (i < slen && (old_buf[i] == new_buf[i]) == skip_same) {
+        i++;
+    }
+    return i;
+}
+
+int __attribute__((target("avx2")))
+xbzrle_encode_buffer_avx2(uint8_t *old_buf, uint8_t *new_buf, int slen,
+                          uint8_t *dst, int dlen)
+{
+    uint32_t zrun_len, nzrun_len;
+    int d = 0, i = 0, start;
+
+    while (i < slen) {
+        /* overflow */
+        if (d + 2 > dlen) {
+            return -1;
+        }
+
+        /* zero run, 32 bytes at a time */
+        start = i;
+        i = xbzrle_skip_avx2(old_buf, new_buf, i, slen, true);
+        zrun_len = i - start;
+
+        /* buffer unchanged */
+        if (zrun_len == slen) {
+            return 0;
+        }
+
+        /* skip last zero run */
+        if (i == slen) {
+            return d;
+        }
+
+        d += uleb128_encode_small(dst + d, zrun_len);
+
+        /* non-zero run, 32 bytes at a time */
+        start = i;
+        i = xbzrle_skip_avx2(old_buf, new_buf, i, slen, false);
+        nzrun_len = i - start;
+
+        /* overflow */
+        if (d + 2 > dlen) {
+            return -1;
+        }
+        d += uleb128_encode_small(dst + d, nzrun_len);
+        if (d + nzrun_len > dlen) {
+            return -1;
+        }
+        memcpy(dst + d, new_buf + start, nzrun_len);
+        d += nzrun_len;
+    }
+
+    return d;
+}
+#endif
+
+#if defined(CONFIG_AVX512BW_OPT)
 
 static int __attribute__((target("avx512bw")))
 xbzrle_encode_buffer_avx512(uint8_t *old_buf, uint8_t *new_buf, int slen,
@@ -136,20 +219,26 @@ xbzrle_encode_buffer_avx512(uint8_t *old_buf, uint8_t *new_buf, int slen,
     }
     return d;
 }
+#endif
 
-static int xbzrle_encode_buffer_int(uint8_t *old_buf, uint8_t *new_buf,
-                                    int slen, uint8_t *dst, int dlen);
-
+#if defined(CONFIG_AVX2_OPT) || defined(CONFIG_AVX512BW_OPT)
 static int (*accel_func)(uint8_t *, uint8_t *, int, uint8_t *, int);
 
 static void __attribute__((constructor)) init_accel(void)
 {
     unsigned info = cpuinfo_init();
+
+    accel_func = xbzrle_encode_buffer_int;
+#if defined(CONFIG_AVX2_OPT)
+    if (info & CPUINFO_AVX2) {
+        accel_func = xbzrle_encode_buffer_avx2;
+    }
+#endif
+#if defined(CONFIG_AVX512BW_OPT)
     if (info & CPUINFO_AVX512BW) {
         accel_func = xbzrle_encode_buffer_avx512;
-    } else {
-        accel_func = xbzrle_encode_buffer_int;
     }
+#endif
 }
 
 int xbzrle_encode_buffer(uint8_t *old_buf, uint8_t *new_buf, int slen,
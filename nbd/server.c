@@ -28,6 +28,7 @@
 #include "nbd-internal.h"
 #include "qemu/units.h"
 #include "qemu/memalign.h"
+#include "sysemu/iothread.h"
 
 #define NBD_META_ID_BASE_ALLOCATION 0
 #define NBD_META_ID_ALLOCATION_DEPTH 1
@@ -75,6 +76,14 @@ static int system_errno_to_nbd_errno(int err)
     }
 }
 
+#define MAX_NBD_REQUESTS 16
+
+/*
+ * Upper bound for the memory kept in a client's pool of recycled request
+ * buffers, see nbd_request_buf_get().
+ */
+#define NBD_BUF_POOL_MAX_BYTES (16 * MiB)
+
 /* Definitions for opaque data types */
 
 typedef struct NBDRequestData NBDRequestData;
@@ -82,9 +91,15 @@ typedef struct NBDRequestData NBDRequestData;
 struct NBDRequestData {
     NBDClient *client;
     uint8_t *data;
+    size_t data_size; /* allocated size of data, may exceed the request */
     bool complete;
 };
 
+typedef struct NBDPooledBuf {
+    void *data;
+    size_t size;
+} NBDPooledBuf;
+
 struct NBDExport {
     BlockExport common;
 
@@ -101,6 +116,11 @@ struct NBDExport {
     bool allocation_depth;
     BdrvDirtyBitmap **export_bitmaps;
     size_t nr_export_bitmaps;
+
+    /* IOThreads that new clients are distributed across, may be empty */
+    IOThread **iothreads;
+    size_t nr_iothreads;
+    size_t next_iothread;
 };
 
 static QTAILQ_HEAD(, NBDExport) exports = QTAILQ_HEAD_INITIALIZER(exports);
@@ -133,6 +153,12 @@ struct NBDClient {
     QIOChannelSocket *sioc; /* The underlying data channel */
     QIOChannel *ioc; /* The current I/O channel which may differ (eg TLS) */
 
+    /*
+     * AioContext that processes the client's requests, or NULL to use the
+     * export's AioContext.  Set when the client is attached to the export.
+     */
+    AioContext *ctx;
+
     Coroutine *recv_coroutine; /* protected by lock */
 
     CoMutex send_lock;
@@ -153,10 +179,38 @@ struct NBDClient {
     uint32_t opt; /* Current option being negotiated */
     uint32_t optlen; /* remaining length of data in ioc for the option being
                         negotiated now */
+
+    /* Recycled request buffers, protected by lock */
+    NBDPooledBuf buf_pool[MAX_NBD_REQUESTS];
+    int nb_pooled_bufs;
+    size_t pooled_bytes;
 };
 
 static void nbd_client_receive_next_request(NBDClient *client);
 
+/* Returns the AioContext in which @client processes requests */
+static AioContext *nbd_client_aio_context(NBDClient *client)
+{
+    return client->ctx ?: client->exp->common.ctx;
+}
+
+/*
+ * Attaches @client to @exp once negotiation has selected the export.
+ * Runs in the main loop thread.
+ */
+static void nbd_export_add_client(NBDExport *exp, NBDClient *client)
+{
+    client->exp = exp;
+    if (exp->nr_iothreads) {
+        IOThread *iothread = exp->iothreads[exp->next_iothread];
+
+        client->ctx = iothread_get_aio_context(iothread);
+        exp->next_iothread = (exp->next_iothread + 1) % exp->nr_iothreads;
+    }
+    QTAILQ_INSERT_TAIL(&exp->clients, client, next);
+    blk_exp_ref(&exp->common);
+}
+
 /* Basic flow for negotiation
 
    Server         Client
@@ -527,8 +581,7 @@ static int nbd_negotiate_handle_export_name(NBDClient *client, bool no_zeroes,
         return ret;
     }
 
-    QTAILQ_INSERT_TAIL(&client->exp->clients, client, next);
-    blk_exp_ref(&client->exp->common);
+    nbd_export_add_client(client->exp, client);
 
     return 0;
 }
@@ -739,10 +792,8 @@ static int nbd_negotiate_handle_info(NBDClient *client, Error **errp)
     }
 
     if (client->opt == NBD_OPT_GO) {
-        client->exp = exp;
         client->check_align = check_align;
-        QTAILQ_INSERT_TAIL(&client->exp->clients, client, next);
-        blk_exp_ref(&client->exp->common);
+        nbd_export_add_client(exp, client);
         rc = 1;
     }
     return rc;
@@ -1508,9 +1559,7 @@ static int coroutine_fn nbd_receive_request(NBDClient *client, NBDRequest *reque
     return 0;
 }
 
-#define MAX_NBD_REQUESTS 16
-
-/* Runs in export AioContext and main loop thread */
+/* Runs in the client's AioContext and main loop thread */
 void nbd_client_get(NBDClient *client)
 {
     qatomic_inc(&client->refcount);
@@ -1537,6 +1586,9 @@ void nbd_client_put(NBDClient *client)
             blk_exp_unref(&client->exp->common);
         }
         g_free(client->contexts.bitmaps);
+        for (int i = 0; i < client->nb_pooled_bufs; i++) {
+            qemu_vfree(client->buf_pool[i].data);
+        }
         qemu_mutex_destroy(&client->lock);
         g_free(client);
     }
@@ -1591,7 +1643,7 @@ static void client_close(NBDClient *client, bool negotiated)
     }
 }
 
-/* Runs in export AioContext with client->lock held */
+/* Runs in the client's AioContext with client->lock held */
 static NBDRequestData *nbd_request_get(NBDClient *client)
 {
     NBDRequestData *req;
@@ -1604,13 +1656,73 @@ static NBDRequestData *nbd_request_get(NBDClient *client)
     return req;
 }
 
-/* Runs in export AioContext with client->lock held */
+/*
+ * Returns a buffer of at least @len bytes for a READ or WRITE request and
+ * stores its actual size in *size.
+ *
+ * Clients that stream data, like backup readers, issue many requests of the
+ * same size; reusing buffers from the previous requests avoids an aligned
+ * allocation and the page faults of touching fresh memory for each of them.
+ *
+ * Runs in the client's AioContext, client->lock must not be held.
+ */
+static void *nbd_request_buf_get(NBDClient *client, size_t len, size_t *size)
+{
+    WITH_QEMU_LOCK_GUARD(&client->lock) {
+        int best = -1;
+
+        /*
+         * Take the smallest buffer that fits, so that small requests do not
+         * use up the buffers that larger requests need.
+         */
+        for (int i = 0; i < client->nb_pooled_bufs; i++) {
+            size_t buf_size = client->buf_pool[i].size;
+
+            if (buf_size >= len &&
+                (best < 0 || buf_size < client->buf_pool[best].size)) {
+                best = i;
+                if (buf_size == len) {
+                    break;
+                }
+            }
+        }
+
+        if (best >= 0) {
+            NBDPooledBuf buf = client->buf_pool[best];
+
+            client->buf_pool[best] = client->buf_pool[--client->nb_pooled_bufs];
+            client->pooled_bytes -= buf.size;
+            *size = buf.size;
+            return buf.data;
+        }
+    }
+
+    *size = len;
+    return blk_try_blockalign(client->exp->common.blk, len);
+}
+
+/* Runs in the client's AioContext with client->lock held */
+static void nbd_request_buf_put(NBDClient *client, void *data, size_t size)
+{
+    if (client->nb_pooled_bufs < MAX_NBD_REQUESTS &&
+        client->pooled_bytes + size <= NBD_BUF_POOL_MAX_BYTES) {
+        client->buf_pool[client->nb_pooled_bufs++] = (NBDPooledBuf) {
+            .data = data,
+            .size = size,
+        };
+        client->pooled_bytes += size;
+    } else {
+        qemu_vfree(data);
+    }
+}
+
+/* Runs in the client's AioContext with client->lock held */
 static void nbd_request_put(NBDRequestData *req)
 {
     NBDClient *client = req->client;
 
     if (req->data) {
-        qemu_vfree(req->data);
+        nbd_request_buf_put(client, req->data, req->data_size);
     }
     g_free(req);
 
@@ -1683,7 +1795,7 @@ static void nbd_drained_end(void *opaque)
     }
 }
 
-/* Runs in export AioContext */
+/* Runs in the client's AioContext */
 static void nbd_wake_read_bh(void *opaque)
 {
     NBDClient *client = opaque;
@@ -1704,12 +1816,12 @@ static bool nbd_drained_poll(void *opaque)
                  * If there's a coroutine waiting for a request on nbd_read_eof()
                  * enter it here so we don't depend on the client to wake it up.
                  *
-                 * Schedule a BH in the export AioContext to avoid missing the
+                 * Schedule a BH in the client's AioContext to avoid missing the
                  * wake up due to the race between qio_channel_wake_read() and
                  * qio_channel_yield().
                  */
                 if (client->recv_coroutine != NULL && client->read_yielding) {
-                    aio_bh_schedule_oneshot(nbd_export_aio_context(client->exp),
+                    aio_bh_schedule_oneshot(nbd_client_aio_context(client),
                                             nbd_wake_read_bh, client);
                 }
 
@@ -1759,6 +1871,7 @@ static int nbd_export_create(BlockExport *blk_exp, BlockExportOptions *exp_args,
     uint64_t perm, shared_perm;
     bool readonly = !exp_args->writable;
     BlockDirtyBitmapOrStrList *bitmaps;
+    strList *iothreads;
     size_t i;
     int ret;
 
@@ -1888,6 +2001,21 @@ static int nbd_export_create(BlockExport *blk_exp, BlockExportOptions *exp_args,
 
     exp->allocation_depth = arg->allocation_depth;
 
+    for (iothreads = arg->iothreads; iothreads; iothreads = iothreads->next) {
+        exp->nr_iothreads++;
+    }
+    exp->iothreads = g_new0(IOThread *, exp->nr_iothreads);
+    for (i = 0, iothreads = arg->iothreads; iothreads;
+         i++, iothreads = iothreads->next) {
+        exp->iothreads[i] = iothread_by_id(iothreads->value);
+        if (!exp->iothreads[i]) {
+            error_setg(errp, "iothread \"%s\" not found", iothreads->value);
+            ret = -ENOENT;
+            goto fail_iothreads;
+        }
+        object_ref(OBJECT(exp->iothreads[i]));
+    }
+
     /*
      * We need to inhibit request queuing in the block layer to ensure we can
      * be properly quiesced when entering a drained section, as our coroutines
@@ -1905,6 +2033,14 @@ static int nbd_export_create(BlockExport *blk_exp, BlockExportOptions *exp_args,
 
     return 0;
 
+fail_iothreads:
+    for (i = 0; i < exp->nr_iothreads && exp->iothreads[i]; i++) {
+        object_unref(OBJECT(exp->iothreads[i]));
+    }
+    g_free(exp->iothreads);
+    for (i = 0; i < exp->nr_export_bitmaps; i++) {
+        bdrv_dirty_bitmap_set_busy(exp->export_bitmaps[i], false);
+    }
 fail:
     bdrv_graph_rdunlock_main_loop();
     g_free(exp->export_bitmaps);
@@ -1977,6 +2113,11 @@ static void nbd_export_delete(BlockExport *blk_exp)
     for (i = 0; i < exp->nr_export_bitmaps; i++) {
         bdrv_dirty_bitmap_set_busy(exp->export_bitmaps[i], false);
     }
+
+    for (i = 0; i < exp->nr_iothreads; i++) {
+        object_unref(OBJECT(exp->iothreads[i]));
+    }
+    g_free(exp->iothreads);
 }
 
 const BlockExportDriver blk_exp_nbd = {
@@ -2716,8 +2857,7 @@ static int coroutine_fn nbd_co_receive_request(NBDRequestData *req,
     }
     if (allocate_buffer) {
         /* READ, WRITE */
-        req->data = blk_try_blockalign(client->exp->common.blk,
-                                       request->len);
+        req->data = nbd_request_buf_get(client, request->len, &req->data_size);
         if (req->data == NULL) {
             error_setg(errp, "No memory");
             return -ENOMEM;
@@ -3134,7 +3274,7 @@ disconnect:
 }
 
 /*
- * Runs in export AioContext and main loop thread. Caller must hold
+ * Runs in the client's AioContext and main loop thread. Caller must hold
  * client->lock.
  */
 static void nbd_client_receive_next_request(NBDClient *client)
@@ -3146,7 +3286,8 @@ static void nbd_client_receive_next_request(NBDClient *client)
         nbd_client_get(client);
         req = nbd_request_get(client);
         client->recv_coroutine = qemu_coroutine_create(nbd_trip, req);
-        aio_co_schedule(client->exp->common.ctx, client->recv_coroutine);
+        aio_co_schedule(nbd_client_aio_context(client),
+                        client->recv_coroutine);
     }
 }
 
@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Benchmark for the HBitmap operations that dirty bitmap users (backup,
+ * mirror, bitmap migration and persistence) run over whole disks.
+ */
+#include "qemu/osdep.h"
+#include "qemu/hbitmap.h"
+#include "qemu/timer.h"
+
+/* One bit per 64 KiB cluster of a 8 TiB disk */
+#define BENCH_BITS (1ULL << 27)
+
+enum bench_op {
+    OP_NEXT_ZERO,
+    OP_ITER,
+    OP_MERGE,
+    OP_DESERIALIZE,
+};
+
+struct benchmark {
+    const char * const name;
+    enum bench_op op;
+};
+
+static const struct benchmark benchmarks[] = {
+    { .name = "next_zero", .op = OP_NEXT_ZERO },
+    { .name = "iter", .op = OP_ITER },
+    { .name = "merge", .op = OP_MERGE },
+    { .name = "deserialize", .op = OP_DESERIALIZE },
+};
+
+/* Percentage of dirty bits, spread in runs of 64 bits */
+static const int densities[] = { 0, 1, 10, 50, 100 };
+
+static void fill(HBitmap *hb, int density)
+{
+    uint64_t run;
+
+    for (run = 0; run < BENCH_BITS / 64; run++) {
+        if (run * 100 / (BENCH_BITS / 64) >= density) {
+            break;
+        }
+        /* Spread the dirty runs across the whole bitmap */
+        hbitmap_set(hb, (run * 97 % (BENCH_BITS / 64)) * 64, 64);
+    }
+}
+
+static int64_t run_benchmark(const struct benchmark *bench, int density)
+{
+    HBitmap *hb = hbitmap_alloc(BENCH_BITS, 0);
+    HBitmap *other = NULL;
+    HBitmapIter hbi;
+    uint8_t *buf = NULL;
+    uint64_t buf_size = 0;
+    int64_t start_ns, ns, pos;
+
+    fill(hb, density);
+
+    switch (bench->op) {
+    case OP_MERGE:
+        other = hbitmap_alloc(BENCH_BITS, 0);
+        break;
+    case OP_DESERIALIZE:
+        buf_size = hbitmap_serialization_size(hb, 0, BENCH_BITS);
+        buf = g_malloc(buf_size);
+        hbitmap_serialize_part(hb, buf, 0, BENCH_BITS);
+        hbitmap_deserialize_part(hb, buf, 0, BENCH_BITS, false);
+        break;
+    default:
+        break;
+    }
+
+    start_ns = get_clock();
+    switch (bench->op) {
+    case OP_NEXT_ZERO:
+        for (pos = 0; pos >= 0 && pos < BENCH_BITS; ) {
+            pos = hbitmap_next_zero(hb, pos, BENCH_BITS - pos);
+            if (pos >= 0) {
+                pos = hbitmap_next_dirty(hb, pos, BENCH_BITS - pos);
+            }
+        }
+        break;
+    case OP_ITER:
+        hbitmap_iter_init(&hbi, hb, 0);
+        while (hbitmap_iter_next(&hbi) >= 0) {
+            /* nothing */
+        }
+        break;
+    case OP_MERGE:
+        hbitmap_merge(other, hb, other);
+        break;
+    case OP_DESERIALIZE:
+        hbitmap_deserialize_finish(hb);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    ns = get_clock() - start_ns;
+
+    g_free(buf);
+    if (other) {
+        hbitmap_free(other);
+    }
+    hbitmap_free(hb);
+
+    return ns;
+}
+
+int main(int argc, char *argv[])
+{
+    printf("# %" PRIu64 " bits. Units: microseconds per operation\n",
+           (uint64_t)BENCH_BITS);
+    printf("%12s ", "Op \\ dirty%");
+    for (int i = 0; i < ARRAY_SIZE(densities); i++) {
+        printf("%10d ", densities[i]);
+    }
+    printf("\n");
+
+    for (int i = 0; i < ARRAY_SIZE(benchmarks); i++) {
+        printf("%12s ", benchmarks[i].name);
+        for (int j = 0; j < ARRAY_SIZE(densities); j++) {
+            int64_t total_ns = 0;
+            int64_t n_runs = 0;
+
+            /* warm-up run */
+            run_benchmark(&benchmarks[i], densities[j]);
+
+            while (total_ns < 2e8 || n_runs < 5) {
+                total_ns += run_benchmark(&benchmarks[i], densities[j]);
+                n_runs++;
+            }
+            printf("%10.1f ", (double)total_ns / n_runs / 1e3);
+        }
+        printf("\n");
+    }
+    return 0;
+}
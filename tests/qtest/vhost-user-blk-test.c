@@ -893,10 +893,10 @@ static void quit_storage_daemon(void *data)
 }
 
 static void start_vhost_user_blk(GString *cmd_line, int vus_instances,
-                                 int num_queues)
+                                 int num_queues, int num_iothreads)
 {
     const char *vhost_user_blk_bin = qtest_qemu_storage_daemon_binary();
-    int i;
+    int i, j;
     gchar *img_path;
     GString *storage_daemon_command = g_string_new(NULL);
     QemuStorageDaemonState *qsd;
@@ -909,6 +909,11 @@ static void start_vhost_user_blk(GString *cmd_line, int vus_instances,
             " -object memory-backend-memfd,id=mem,size=256M,share=on "
             " -M memory-backend=mem -m 256M ");
 
+    for (j = 0; j < num_iothreads; j++) {
+        g_string_append_printf(storage_daemon_command,
+                               "--object iothread,id=iothread%d ", j);
+    }
+
     for (i = 0; i < vus_instances; i++) {
         int fd;
         char *sock_path = create_listen_socket(&fd);
@@ -918,8 +923,13 @@ static void start_vhost_user_blk(GString *cmd_line, int vus_instances,
         g_string_append_printf(storage_daemon_command,
             "--blockdev driver=file,node-name=disk%d,filename=%s "
             "--export type=vhost-user-blk,id=disk%d,addr.type=fd,addr.str=%d,"
-            "node-name=disk%i,writable=on,num-queues=%d ",
+            "node-name=disk%i,writable=on,num-queues=%d",
             i, img_path, i, fd, i, num_queues);
+        for (j = 0; j < num_iothreads; j++) {
+            g_string_append_printf(storage_daemon_command,
+                                   ",iothreads.%d=iothread%d", j, j);
+        }
+        g_string_append_c(storage_daemon_command, ' ');
 
         g_string_append_printf(cmd_line, "-chardev socket,id=char%d,path=%s ",
                                i + 1, sock_path);
@@ -953,7 +963,7 @@ static void start_vhost_user_blk(GString *cmd_line, int vus_instances,
 
 static void *vhost_user_blk_test_setup(GString *cmd_line, void *arg)
 {
-    start_vhost_user_blk(cmd_line, 1, 1);
+    start_vhost_user_blk(cmd_line, 1, 1, 0);
     return arg;
 }
 
@@ -967,13 +977,27 @@ static void *vhost_user_blk_test_setup(GString *cmd_line, void *arg)
 static void *vhost_user_blk_hotplug_test_setup(GString *cmd_line, void *arg)
 {
     /* "-chardev socket,id=char2" is used for pci_hotplug*/
-    start_vhost_user_blk(cmd_line, 2, 1);
+    start_vhost_user_blk(cmd_line, 2, 1, 0);
     return arg;
 }
 
 static void *vhost_user_blk_multiqueue_test_setup(GString *cmd_line, void *arg)
 {
-    start_vhost_user_blk(cmd_line, 2, 8);
+    start_vhost_user_blk(cmd_line, 2, 8, 0);
+    return arg;
+}
+
+/* Process the virtqueues in IOThreads instead of the main loop */
+static void *vhost_user_blk_iothreads_test_setup(GString *cmd_line, void *arg)
+{
+    start_vhost_user_blk(cmd_line, 1, 1, 2);
+    return arg;
+}
+
+static void *vhost_user_blk_multiqueue_iothreads_test_setup(GString *cmd_line,
+                                                            void *arg)
+{
+    start_vhost_user_blk(cmd_line, 2, 8, 2);
     return arg;
 }
 
@@ -1009,6 +1033,14 @@ static void register_vhost_user_blk_test(void)
 
     opts.before = vhost_user_blk_multiqueue_test_setup;
     qos_add_test("multiqueue", "vhost-user-blk-pci", multiqueue, &opts);
+
+    opts.before = vhost_user_blk_iothreads_test_setup;
+    qos_add_test("basic-iothreads", "vhost-user-blk", basic, &opts);
+    qos_add_test("indirect-iothreads", "vhost-user-blk", indirect, &opts);
+
+    opts.before = vhost_user_blk_multiqueue_iothreads_test_setup;
+    qos_add_test("multiqueue-iothreads", "vhost-user-blk-pci", multiqueue,
+                 &opts);
 }
 
 libqos_init(register_vhost_user_blk_test);
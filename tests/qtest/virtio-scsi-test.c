@@ -10,9 +10,12 @@
 
 #include "qemu/osdep.h"
 #include "libqtest-single.h"
+#include "qemu/bswap.h"
 #include "qemu/module.h"
 #include "scsi/constants.h"
 #include "libqos/libqos-pc.h"
+#include "libqos/malloc-pc.h"
+#include "libqos/pci-pc.h"
 #include "libqos/libqos-spapr.h"
 #include "libqos/virtio.h"
 #include "libqos/virtio-pci.h"
@@ -59,14 +62,15 @@ static uint64_t qvirtio_scsi_alloc(QVirtioSCSIQueues *vs, size_t alloc_size,
     return addr;
 }
 
-static uint8_t virtio_scsi_do_command(QVirtioSCSIQueues *vs,
-                                      const uint8_t *cdb,
-                                      const uint8_t *data_in,
-                                      size_t data_in_len,
-                                      uint8_t *data_out, size_t data_out_len,
-                                      struct virtio_scsi_cmd_resp *resp_out)
+static uint8_t virtio_scsi_do_command_vq(QVirtioSCSIQueues *vs,
+                                         QVirtQueue *vq,
+                                         const uint8_t *cdb,
+                                         const uint8_t *data_in,
+                                         size_t data_in_len,
+                                         uint8_t *data_out,
+                                         size_t data_out_len,
+                                         struct virtio_scsi_cmd_resp *resp_out)
 {
-    QVirtQueue *vq;
     struct virtio_scsi_cmd_req req = { { 0 } };
     struct virtio_scsi_cmd_resp resp = { .response = 0xff, .status = 0xff };
     uint64_t req_addr, resp_addr, data_in_addr = 0, data_out_addr = 0;
@@ -74,8 +78,6 @@ static uint8_t virtio_scsi_do_command(QVirtioSCSIQueues *vs,
     uint32_t free_head;
     QTestState *qts = global_qtest;
 
-    vq = vs->vq[2];
-
     req.lun[0] = 1; /* Select LUN */
     req.lun[1] = 1; /* Select target 1 */
     memcpy(req.cdb, cdb, VIRTIO_SCSI_CDB_SIZE);
@@ -118,6 +120,50 @@ static uint8_t virtio_scsi_do_command(QVirtioSCSIQueues *vs,
     return response;
 }
 
+static uint8_t virtio_scsi_do_command(QVirtioSCSIQueues *vs,
+                                      const uint8_t *cdb,
+                                      const uint8_t *data_in,
+                                      size_t data_in_len,
+                                      uint8_t *data_out, size_t data_out_len,
+                                      struct virtio_scsi_cmd_resp *resp_out)
+{
+    return virtio_scsi_do_command_vq(vs, vs->vq[2], cdb, data_in, data_in_len,
+                                     data_out, data_out_len, resp_out);
+}
+
+/* Send a TMF for target 1, LUN 0 and return its response */
+static uint8_t virtio_scsi_do_tmf(QVirtioSCSIQueues *vs, uint32_t subtype)
+{
+    QVirtQueue *vq = vs->vq[0];
+    struct virtio_scsi_ctrl_tmf_req req = {
+        .type = cpu_to_le32(VIRTIO_SCSI_T_TMF),
+        .subtype = cpu_to_le32(subtype),
+        .lun = { 1, 1 },
+    };
+    struct virtio_scsi_ctrl_tmf_resp resp = { .response = 0xff };
+    uint64_t req_addr, resp_addr;
+    uint8_t response;
+    uint32_t free_head;
+    QTestState *qts = global_qtest;
+
+    /* Only used on x86, where both legacy and modern devices are LE */
+    req_addr = qvirtio_scsi_alloc(vs, sizeof(req), &req);
+    free_head = qvirtqueue_add(qts, vq, req_addr, sizeof(req), false, true);
+    resp_addr = qvirtio_scsi_alloc(vs, sizeof(resp), &resp);
+    qvirtqueue_add(qts, vq, resp_addr, sizeof(resp), true, false);
+
+    qvirtqueue_kick(qts, vs->dev, vq, free_head);
+    qvirtio_wait_used_elem(qts, vs->dev, vq, free_head, NULL,
+                           QVIRTIO_SCSI_TIMEOUT_US);
+
+    response = readb(resp_addr +
+                     offsetof(struct virtio_scsi_ctrl_tmf_resp, response));
+
+    guest_free(alloc, req_addr);
+    guest_free(alloc, resp_addr);
+    return response;
+}
+
 static QVirtioSCSIQueues *qvirtio_scsi_init(QVirtioDevice *dev)
 {
     QVirtioSCSIQueues *vs;
@@ -359,6 +405,87 @@ static void *virtio_scsi_setup_iothread(GString *cmd_line, void *arg)
     return arg;
 }
 
+/*
+ * Spread two command virtqueues over two IOThreads.  This needs the JSON
+ * -device syntax for iothread-vq-mapping, so the test starts QEMU itself
+ * instead of going through the qgraph.
+ */
+static void test_iothread_vq_mapping(void)
+{
+    QGuestAllocator t_alloc;
+    QPCIBus *bus;
+    QVirtioPCIDevice *dev;
+    QVirtioSCSIQueues *vs;
+    QPCIAddress addr = { .devfn = QPCI_DEVFN(4, 0) };
+    struct virtio_scsi_cmd_resp resp;
+    uint8_t buf[512] = { 0 };
+    const uint8_t write_cdb[VIRTIO_SCSI_CDB_SIZE] = {
+        /* WRITE(10) to LBA 0, transfer length 1 */
+        0x2a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00
+    };
+    const uint8_t read_cdb[VIRTIO_SCSI_CDB_SIZE] = {
+        /* READ(10) from LBA 0, transfer length 1 */
+        0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00
+    };
+    int i;
+
+    /* Stop the QEMU that the qgraph tests share */
+    qtest_end();
+    qos_invalidate_command_line();
+
+    qtest_start("-object iothread,id=iothread0 "
+                "-object iothread,id=iothread1 "
+                "-blockdev driver=null-co,read-zeroes=on,node-name=null0 "
+                "-device '{\"driver\": \"virtio-scsi-pci\", "
+                "\"id\": \"vs0\", \"addr\": \"04.0\", "
+                "\"num_queues\": 2, \"iothread-vq-mapping\": "
+                "[{\"iothread\": \"iothread0\"}, "
+                "{\"iothread\": \"iothread1\"}]}' "
+                "-device scsi-hd,bus=vs0.0,drive=null0,scsi-id=1,lun=0");
+
+    pc_alloc_init(&t_alloc, global_qtest, ALLOC_NO_FLAGS);
+    alloc = &t_alloc;
+    bus = qpci_new_pc(global_qtest, alloc);
+    dev = virtio_pci_new(bus, &addr);
+    g_assert_nonnull(dev);
+    qvirtio_pci_start_hw(&dev->obj);
+
+    vs = qvirtio_scsi_init(&dev->vdev);
+    g_assert_cmpint(vs->num_queues, ==, 2);
+
+    /* Requests on both command virtqueues, one for each IOThread */
+    for (i = 0; i < vs->num_queues; i++) {
+        QVirtQueue *vq = vs->vq[2 + i];
+
+        g_assert_cmphex(virtio_scsi_do_command_vq(vs, vq, write_cdb, buf,
+                                                  sizeof(buf), NULL, 0,
+                                                  &resp),
+                        ==, 0);
+        g_assert_cmphex(resp.status, ==, 0);
+
+        g_assert_cmphex(virtio_scsi_do_command_vq(vs, vq, read_cdb, NULL, 0,
+                                                  buf, sizeof(buf), &resp),
+                        ==, 0);
+        g_assert_cmphex(resp.status, ==, 0);
+    }
+
+    /* TMFs that visit the requests in every IOThread complete */
+    g_assert_cmphex(virtio_scsi_do_tmf(vs, VIRTIO_SCSI_T_TMF_ABORT_TASK),
+                    ==, VIRTIO_SCSI_S_OK);
+    g_assert_cmphex(virtio_scsi_do_tmf(vs, VIRTIO_SCSI_T_TMF_ABORT_TASK_SET),
+                    ==, VIRTIO_SCSI_S_OK);
+    g_assert_cmphex(virtio_scsi_do_tmf(vs, VIRTIO_SCSI_T_TMF_QUERY_TASK_SET),
+                    ==, VIRTIO_SCSI_S_OK);
+
+    qvirtio_scsi_pci_free(vs);
+    qos_object_destroy(&dev->obj);
+    qpci_free_pc(bus);
+    alloc_destroy(&t_alloc);
+    alloc = NULL;
+    qtest_end();
+    qos_invalidate_command_line();
+}
+
 static void register_virtio_scsi_test(void)
 {
     QOSGraphTestOptions opts = { };
@@ -383,6 +510,12 @@ static void register_virtio_scsi_test(void)
     };
     qos_add_test("iothread-attach-node", "virtio-scsi-pci",
                  test_iothread_attach_node, &opts);
+
+    if (g_str_equal(qtest_get_arch(), "i386") ||
+        g_str_equal(qtest_get_arch(), "x86_64")) {
+        qtest_add_func("virtio-scsi/iothread-vq-mapping",
+                       test_iothread_vq_mapping);
+    }
 }
 
 libqos_init(register_virtio_scsi_test);
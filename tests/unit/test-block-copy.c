@@ -0,0 +1,172 @@
+/*
+ * Block copy tests
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "block/block_int.h"
+#include "block/block-copy.h"
+#include "qapi/error.h"
+#include "qemu/coroutine.h"
+#include "qemu/main-loop.h"
+#include "qemu/timer.h"
+#include "qemu/units.h"
+
+#define TEST_CLUSTER_SIZE (64 * KiB)
+#define TEST_DISK_SIZE (64 * MiB)
+
+/* Limits of the adaptive chunk size for buffered copies */
+#define INITIAL_CHUNK (1 * MiB)
+#define MIN_CHUNK (256 * KiB)
+#define MAX_CHUNK (8 * MiB)
+
+/* Enough tasks to go from one limit to the other several times */
+#define ADAPT_TASKS 1024
+
+static int coroutine_fn
+bdrv_test_co_get_info(BlockDriverState *bs, BlockDriverInfo *bdi)
+{
+    bdi->cluster_size = TEST_CLUSTER_SIZE;
+    return 0;
+}
+
+static BlockDriver bdrv_test = {
+    .format_name            = "test",
+    .bdrv_co_get_info       = bdrv_test_co_get_info,
+};
+
+static void bdrv_test_parent_child_perm(BlockDriverState *bs, BdrvChild *c,
+                                        BdrvChildRole role,
+                                        BlockReopenQueue *reopen_queue,
+                                        uint64_t perm, uint64_t shared,
+                                        uint64_t *nperm, uint64_t *nshared)
+{
+    *nperm = BLK_PERM_CONSISTENT_READ | BLK_PERM_WRITE;
+    *nshared = BLK_PERM_ALL;
+}
+
+/* Owns the source and target children that block-copy works on */
+static BlockDriver bdrv_test_parent = {
+    .format_name            = "test-parent",
+    .bdrv_child_perm        = bdrv_test_parent_child_perm,
+};
+
+typedef struct AdaptTest {
+    BlockCopyState *bcs;
+
+    /* Every task takes a fixed time plus a time proportional to its size */
+    int64_t latency_fixed_ns;
+    int64_t latency_ns_per_mib;
+
+    int64_t min_chunk;
+    int64_t max_chunk;
+    int64_t last_chunk;
+    bool done;
+} AdaptTest;
+
+static void coroutine_fn adapt_test_entry(void *opaque)
+{
+    AdaptTest *t = opaque;
+    int64_t chunk = INITIAL_CHUNK;
+    int i;
+
+    t->min_chunk = t->max_chunk = chunk;
+    for (i = 0; i < ADAPT_TASKS; i++) {
+        int64_t ns = t->latency_fixed_ns +
+                     chunk * t->latency_ns_per_mib / MiB;
+
+        chunk = block_copy_adapt_buffer_size(t->bcs, chunk, ns);
+        t->min_chunk = MIN(t->min_chunk, chunk);
+        t->max_chunk = MAX(t->max_chunk, chunk);
+    }
+
+    t->last_chunk = chunk;
+    t->done = true;
+}
+
+/*
+ * Reports ADAPT_TASKS full-sized buffered copy tasks to a new block-copy
+ * state, with the timings given in @t, and records the chunk sizes that it
+ * picks.
+ */
+static void run_adapt_test(AdaptTest *t)
+{
+    BlockDriverState *parent, *src, *tgt;
+    BdrvChild *src_child, *tgt_child;
+    Coroutine *co;
+
+    parent = bdrv_new_open_driver(&bdrv_test_parent, "parent", BDRV_O_RDWR,
+                                  &error_abort);
+    src = bdrv_new_open_driver(&bdrv_test, "source", BDRV_O_RDWR,
+                               &error_abort);
+    tgt = bdrv_new_open_driver(&bdrv_test, "target", BDRV_O_RDWR,
+                               &error_abort);
+    src->total_sectors = TEST_DISK_SIZE >> BDRV_SECTOR_BITS;
+    tgt->total_sectors = TEST_DISK_SIZE >> BDRV_SECTOR_BITS;
+
+    /* Takes our references to src and tgt */
+    bdrv_graph_wrlock();
+    src_child = bdrv_attach_child(parent, src, "source", &child_of_bds,
+                                  BDRV_CHILD_DATA, &error_abort);
+    tgt_child = bdrv_attach_child(parent, tgt, "target", &child_of_bds,
+                                  BDRV_CHILD_DATA, &error_abort);
+    bdrv_graph_wrunlock();
+
+    t->bcs = block_copy_state_new(src_child, tgt_child, NULL, &error_abort);
+
+    /* Nothing else uses the state, so this never yields */
+    co = qemu_coroutine_create(adapt_test_entry, t);
+    qemu_coroutine_enter(co);
+    g_assert(t->done);
+
+    block_copy_state_free(t->bcs);
+    bdrv_unref(parent);
+}
+
+/*
+ * Requests cost the same whatever their size: the chunk size grows until it
+ * hits the upper limit, and never goes beyond.
+ */
+static void test_adapt_grow(void)
+{
+    AdaptTest t = {
+        .latency_fixed_ns = 1 * SCALE_MS,
+    };
+
+    run_adapt_test(&t);
+
+    g_assert_cmpint(t.max_chunk, ==, MAX_CHUNK);
+    g_assert_cmpint(t.min_chunk, ==, INITIAL_CHUNK);
+}
+
+/*
+ * Throughput is the same whatever the request size: smaller chunks are
+ * preferred, down to the lower limit where the chunk size then stays.
+ */
+static void test_adapt_shrink(void)
+{
+    AdaptTest t = {
+        .latency_ns_per_mib = 4 * SCALE_MS,
+    };
+
+    run_adapt_test(&t);
+
+    g_assert_cmpint(t.min_chunk, ==, MIN_CHUNK);
+    g_assert_cmpint(t.last_chunk, ==, MIN_CHUNK);
+    g_assert_cmpint(t.max_chunk, <=, MAX_CHUNK);
+}
+
+int main(int argc, char **argv)
+{
+    bdrv_init();
+    qemu_init_main_loop(&error_abort);
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/block-copy/adapt/grow", test_adapt_grow);
+    g_test_add_func("/block-copy/adapt/shrink", test_adapt_shrink);
+
+    return g_test_run();
+}
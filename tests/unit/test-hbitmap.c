@@ -398,6 +398,46 @@ static void test_hbitmap_reset_all(TestHBitmapData *data,
     hbitmap_test_reset_all(data);
 }
 
+/* Merge @other into @data, with @data->hb passed as either operand */
+static void hbitmap_test_merge(TestHBitmapData *data, TestHBitmapData *other,
+                               bool data_first)
+{
+    size_t i;
+
+    if (data_first) {
+        hbitmap_merge(data->hb, other->hb, data->hb);
+    } else {
+        hbitmap_merge(other->hb, data->hb, data->hb);
+    }
+    for (i = 0; i < hbitmap_test_array_size(data->size); i++) {
+        data->bits[i] |= other->bits[i];
+    }
+    hbitmap_test_check(data, 0);
+}
+
+static void test_hbitmap_merge(TestHBitmapData *data,
+                               const void *unused)
+{
+    TestHBitmapData other = {};
+
+    hbitmap_test_init(data, L3 * 2, 0);
+    hbitmap_test_init(&other, L3 * 2, 0);
+
+    hbitmap_test_merge(data, &other, true);
+    hbitmap_test_set(&other, L1 - 1, L1 + 2);
+    hbitmap_test_merge(data, &other, true);
+    hbitmap_test_set(data, L2, L1);
+    hbitmap_test_set(&other, L2 + L1 / 2, L1);
+    hbitmap_test_merge(data, &other, false);
+    hbitmap_test_set(&other, L3 - 1, 3);
+    hbitmap_test_set(&other, L3 * 2 - 1, 1);
+    hbitmap_test_merge(data, &other, true);
+    hbitmap_test_set(&other, L3 / 2, L3);
+    hbitmap_test_merge(data, &other, false);
+
+    hbitmap_test_teardown(&other, NULL);
+}
+
 static void test_hbitmap_granularity(TestHBitmapData *data,
                                      const void *unused)
 {
@@ -1061,6 +1101,7 @@ int main(int argc, char **argv)
     hbitmap_test_add("/hbitmap/reset/empty", test_hbitmap_reset_empty);
     hbitmap_test_add("/hbitmap/reset/general", test_hbitmap_reset);
     hbitmap_test_add("/hbitmap/reset/all", test_hbitmap_reset_all);
+    hbitmap_test_add("/hbitmap/merge", test_hbitmap_merge);
     hbitmap_test_add("/hbitmap/granularity", test_hbitmap_granularity);
 
     hbitmap_test_add("/hbitmap/truncate/nop", test_hbitmap_truncate_nop);
@@ -46,6 +46,7 @@ struct QIOChannelTLSTestData {
     bool expectClientFail;
     const char *hostname;
     const char *const *wildcards;
+    bool ktls;
 };
 
 struct QIOChannelTLSHandshakeData {
@@ -198,6 +199,16 @@ static void test_io_channel_tls(const void *opaque)
         "channeltlsacl", &error_abort);
     g_assert(serverChanTLS != NULL);
 
+    /*
+     * Hands the socket to the TLS library. A socketpair cannot do
+     * kernel TLS, so this tests the fallback to userspace records
+     * on a library-owned socket.
+     */
+    if (data->ktls) {
+        qio_channel_tls_enable_ktls(clientChanTLS);
+        qio_channel_tls_enable_ktls(serverChanTLS);
+    }
+
     qio_channel_tls_handshake(clientChanTLS,
                               test_tls_handshake_done,
                               &clientHandshake,
@@ -280,11 +291,11 @@ int main(int argc, char **argv)
 # define TEST_CHANNEL(name, caCrt,                                      \
                       serverCrt, clientCrt,                             \
                       expectServerFail, expectClientFail,               \
-                      hostname, wildcards)                              \
+                      hostname, wildcards, ktls)                        \
     struct QIOChannelTLSTestData name = {                               \
         caCrt, caCrt, serverCrt, clientCrt,                             \
         expectServerFail, expectClientFail,                             \
-        hostname, wildcards                                             \
+        hostname, wildcards, ktls                                       \
     };                                                                  \
     g_test_add_data_func("/qio/channel/tls/" # name,                    \
                          &name, test_io_channel_tls);
@@ -319,7 +330,10 @@ int main(int argc, char **argv)
     };
     TEST_CHANNEL(basic, cacertreq.filename, servercertreq.filename,
                  clientcertreq.filename, false, false,
-                 "qemu.org", wildcards);
+                 "qemu.org", wildcards, false);
+    TEST_CHANNEL(ktls, cacertreq.filename, servercertreq.filename,
+                 clientcertreq.filename, false, false,
+                 "qemu.org", wildcards, true);
 
     ret = g_test_run();
 
@@ -364,6 +364,28 @@ static void test_enabled(void)
     }
 }
 
+static void test_direction_enabled(void)
+{
+    int i;
+
+    throttle_config_init(&cfg);
+    g_assert(!throttle_direction_enabled(&cfg, THROTTLE_READ));
+    g_assert(!throttle_direction_enabled(&cfg, THROTTLE_WRITE));
+
+    for (i = 0; i < BUCKETS_COUNT; i++) {
+        bool is_total = i == THROTTLE_BPS_TOTAL || i == THROTTLE_OPS_TOTAL;
+        bool is_read = i == THROTTLE_BPS_READ || i == THROTTLE_OPS_READ;
+        bool is_write = i == THROTTLE_BPS_WRITE || i == THROTTLE_OPS_WRITE;
+
+        throttle_config_init(&cfg);
+        set_cfg_value(false, i, 150);
+        g_assert(throttle_direction_enabled(&cfg, THROTTLE_READ) ==
+                 (is_total || is_read));
+        g_assert(throttle_direction_enabled(&cfg, THROTTLE_WRITE) ==
+                 (is_total || is_write));
+    }
+}
+
 /* tests functions for throttle_conflicting */
 
 static void test_conflicts_for_one_set(bool is_max,
@@ -821,6 +843,8 @@ int main(int argc, char **argv)
     g_test_add_func("/throttle/have_timer",         test_have_timer);
     g_test_add_func("/throttle/detach_attach",      test_detach_attach);
     g_test_add_func("/throttle/config/enabled",     test_enabled);
+    g_test_add_func("/throttle/config/direction_enabled",
+                    test_direction_enabled);
     g_test_add_func("/throttle/config/conflicting", test_conflicting_config);
     g_test_add_func("/throttle/config/is_valid",    test_is_valid);
     g_test_add_func("/throttle/config/ranges",      test_ranges);
@@ -14,6 +14,10 @@
 #include "qemu/cutils.h"
 #include "../migration/xbzrle.h"
 
+#if defined(CONFIG_AVX2_OPT)
+#include "host/cpuinfo.h"
+#endif
+
 #define XBZRLE_PAGE_SIZE 4096
 
 static void test_uleb(void)
@@ -173,6 +177,116 @@ static void test_encode_decode(void)
     }
 }
 
+#if defined(CONFIG_AVX2_OPT)
+/*
+ * Encode @new_buf against @old_buf with the scalar and the AVX2 encoders,
+ * with room for the whole page and with destinations that are just around
+ * or well below the encoded size, and check that both agree.
+ */
+static void encode_compare_avx2(uint8_t *old_buf, uint8_t *new_buf, int slen)
+{
+    uint8_t *dst_int = g_malloc(XBZRLE_PAGE_SIZE);
+    uint8_t *dst_avx2 = g_malloc(XBZRLE_PAGE_SIZE);
+    int dlens[6];
+    int ret_int, ret_avx2, i;
+
+    ret_int = xbzrle_encode_buffer_int(old_buf, new_buf, slen,
+                                       dst_int, slen);
+    ret_avx2 = xbzrle_encode_buffer_avx2(old_buf, new_buf, slen,
+                                         dst_avx2, slen);
+    g_assert_cmpint(ret_int, ==, ret_avx2);
+
+    dlens[0] = 0;
+    dlens[1] = 1;
+    dlens[2] = g_test_rand_int_range(0, slen + 1);
+    /* The size of an encoding that overflowed is not known, use half */
+    dlens[3] = ret_int < 0 ? slen / 2 : ret_int;
+    dlens[4] = MAX(dlens[3] - 1, 0);
+    dlens[5] = MIN(dlens[3] + 1, slen);
+
+    for (i = 0; i < ARRAY_SIZE(dlens); i++) {
+        ret_int = xbzrle_encode_buffer_int(old_buf, new_buf, slen,
+                                           dst_int, dlens[i]);
+        ret_avx2 = xbzrle_encode_buffer_avx2(old_buf, new_buf, slen,
+                                             dst_avx2, dlens[i]);
+        g_assert_cmpint(ret_int, ==, ret_avx2);
+        g_assert_cmpint(ret_int, <=, dlens[i]);
+        if (ret_int > 0) {
+            g_assert(memcmp(dst_int, dst_avx2, ret_int) == 0);
+        }
+    }
+
+    g_free(dst_int);
+    g_free(dst_avx2);
+}
+
+/*
+ * Lengths for the encoders: they must be a multiple of sizeof(long), but
+ * not necessarily of the 32 bytes the AVX2 encoder compares at a time
+ */
+static int encode_avx2_slen(void)
+{
+    static const int fixed[] = {
+        sizeof(long), 40, XBZRLE_PAGE_SIZE - 24,
+        XBZRLE_PAGE_SIZE - sizeof(long), XBZRLE_PAGE_SIZE,
+    };
+    int n = g_test_rand_int_range(0, ARRAY_SIZE(fixed) + 1);
+
+    if (n < ARRAY_SIZE(fixed)) {
+        return fixed[n];
+    }
+    return sizeof(long) *
+        g_test_rand_int_range(1, XBZRLE_PAGE_SIZE / sizeof(long) + 1);
+}
+
+static void test_encode_avx2(void)
+{
+    uint8_t *old_buf = g_malloc(XBZRLE_PAGE_SIZE);
+    uint8_t *new_buf = g_malloc(XBZRLE_PAGE_SIZE);
+    int i, j, slen, runs, off, len;
+
+    if (!(cpuinfo_init() & CPUINFO_AVX2)) {
+        g_test_skip("AVX2 not supported by the host");
+        goto out;
+    }
+
+    for (i = 0; i < XBZRLE_PAGE_SIZE; i++) {
+        old_buf[i] = g_test_rand_int();
+    }
+
+    for (i = 0; i < 2000; i++) {
+        slen = encode_avx2_slen();
+
+        /* random page, mostly different from the old one */
+        for (j = 0; j < slen; j++) {
+            new_buf[j] = g_test_rand_int();
+        }
+        encode_compare_avx2(old_buf, new_buf, slen);
+
+        /* sparse differences, one of them up to the end of the page */
+        memcpy(new_buf, old_buf, slen);
+        runs = g_test_rand_int_range(0, 16);
+        for (j = 0; j <= runs; j++) {
+            len = g_test_rand_int_range(1, MIN(slen, 80) + 1);
+            off = j == runs ? slen - len
+                            : g_test_rand_int_range(0, slen - len + 1);
+            while (len--) {
+                new_buf[off + len] = ~old_buf[off + len];
+            }
+        }
+        encode_compare_avx2(old_buf, new_buf, slen);
+
+        /* unchanged page */
+        memcpy(new_buf, old_buf, slen);
+        encode_compare_avx2(old_buf, new_buf, slen);
+    }
+
+out:
+    g_free(old_buf);
+    g_free(new_buf);
+}
+#endif
+
 int main(int argc, char **argv)
 {
     g_test_init(&argc, &argv, NULL);
@@ -185,6 +299,9 @@ int main(int argc, char **argv)
     g_test_add_func("/xbzrle/encode_decode_overflow",
                     test_encode_decode_overflow);
     g_test_add_func("/xbzrle/encode_decode", test_encode_decode);
+#if defined(CONFIG_AVX2_OPT)
+    g_test_add_func("/xbzrle/encode_avx2", test_encode_avx2);
+#endif
 
     return g_test_run();
 }
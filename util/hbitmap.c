@@ -12,9 +12,13 @@
 #include "qemu/osdep.h"
 #include "qemu/hbitmap.h"
 #include "qemu/host-utils.h"
+#include "qemu/cutils.h"
 #include "trace.h"
 #include "crypto/hash.h"
 
+/* Number of words hbitmap_next_zero() checks at once in dirty areas */
+#define HBITMAP_SCAN_WORDS 8
+
 /* HBitmaps provides an array of bits.  The bits are stored as usual in an
  * array of unsigned longs, but HBitmap is also optimized to provide fast
  * iteration over set bits; going from one bit to the next is O(logB n)
@@ -245,9 +249,28 @@ int64_t hbitmap_next_zero(const HBitmap *hb, int64_t start, int64_t count)
     assert((start >> hb->granularity) < hb->size);
 
     if (cur == (unsigned long)-1) {
-        do {
+        pos++;
+
+        /*
+         * Skip fully dirty areas a block of words at a time.  The inner loop
+         * has no early exit, so the compiler can vectorize it.
+         */
+        while (pos + HBITMAP_SCAN_WORDS <= sz) {
+            unsigned long all = (unsigned long)-1;
+            int i;
+
+            for (i = 0; i < HBITMAP_SCAN_WORDS; i++) {
+                all &= last_lev[pos + i];
+            }
+            if (all != (unsigned long)-1) {
+                break;
+            }
+            pos += HBITMAP_SCAN_WORDS;
+        }
+
+        while (pos < sz && last_lev[pos] == (unsigned long)-1) {
             pos++;
-        } while (pos < sz && last_lev[pos] == (unsigned long)-1);
+        }
 
         if (pos >= sz) {
             return -1;
@@ -770,6 +793,17 @@ void hbitmap_deserialize_finish(HBitmap *bitmap)
         memset(bitmap->levels[lev], 0, size * sizeof(unsigned long));
 
         for (i = 0; i < prev_size; ++i) {
+            /*
+             * Whole words of the upper level stay zero for clean areas, let
+             * buffer_is_zero() skip those quickly.
+             */
+            if (!(i & (BITS_PER_LONG - 1)) &&
+                buffer_is_zero(&bitmap->levels[lev + 1][i],
+                               MIN(BITS_PER_LONG, prev_size - i) *
+                               sizeof(unsigned long))) {
+                i += BITS_PER_LONG - 1;
+                continue;
+            }
             if (bitmap->levels[lev + 1][i]) {
                 bitmap->levels[lev][i >> BITS_PER_LEVEL] |=
                     1UL << (i & (BITS_PER_LONG - 1));
@@ -892,6 +926,35 @@ static void hbitmap_sparse_merge(HBitmap *dst, const HBitmap *src)
     }
 }
 
+/*
+ * ORs word @pos of @level of @src into @dst and recurses into the words of the
+ * next level below every bit set in it.  Only the words that are populated
+ * in @src are visited, so merging a sparse bitmap is cheap however large the
+ * bitmaps are.  The depth is limited to HBITMAP_LEVELS.
+ */
+static void hb_merge_word(HBitmap *dst, const HBitmap *src, int level,
+                          uint64_t pos)
+{
+    unsigned long cur = src->levels[level][pos];
+
+    if (level == HBITMAP_LEVELS - 1) {
+        dst->count += ctpopl(cur & ~dst->levels[level][pos]);
+        dst->levels[level][pos] |= cur;
+        return;
+    }
+
+    dst->levels[level][pos] |= cur;
+    while (cur) {
+        uint64_t next = (pos << BITS_PER_LEVEL) + ctzl(cur);
+
+        cur &= cur - 1;
+        /* Skips the sentinel in level 0 */
+        if (next < src->sizes[level + 1]) {
+            hb_merge_word(dst, src, level + 1, next);
+        }
+    }
+}
+
 /**
  * Given HBitmaps A and B, let R := A (BITOR) B.
  * Bitmaps A and B will not be modified,
@@ -929,11 +992,22 @@ void hbitmap_merge(const HBitmap *a, const HBitmap *b, HBitmap *result)
         return;
     }
 
+    assert(a->size == b->size);
+
+    /*
+     * Merging into one of the operands only needs to touch the words that
+     * are populated in the other one, and the upper levels tell us which
+     * those are.
+     */
+    if (result == a || result == b) {
+        hb_merge_word(result, result == a ? b : a, 0, 0);
+        return;
+    }
+
     /* This merge is O(size), as BITS_PER_LONG and HBITMAP_LEVELS are constant.
      * It may be possible to improve running times for sparsely populated maps
      * by using hbitmap_iter_next, but this is suboptimal for dense maps.
      */
-    assert(a->size == b->size);
     for (i = HBITMAP_LEVELS - 1; i >= 0; i--) {
         for (j = 0; j < a->sizes[i]; j++) {
             result->levels[i][j] = a->levels[i][j] | b->levels[i][j];
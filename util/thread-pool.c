@@ -295,6 +295,12 @@ void thread_pool_submit(ThreadPoolFunc *func, void *arg)
     thread_pool_submit_aio(func, arg, NULL, NULL);
 }
 
+int thread_pool_max_cpu_jobs(void)
+{
+    return MIN(MAX(g_get_num_processors(), 4),
+               THREAD_POOL_MAX_THREADS_DEFAULT);
+}
+
 void thread_pool_update_params(ThreadPool *pool, AioContext *ctx)
 {
     qemu_mutex_lock(&pool->lock);
@@ -308,6 +308,32 @@ bool throttle_enabled(ThrottleConfig *cfg)
     return false;
 }
 
+/* Return true if any limit applies to requests of the given direction
+ *
+ * @cfg:       the throttling configuration to inspect
+ * @direction: the ThrottleDirection
+ */
+bool throttle_direction_enabled(ThrottleConfig *cfg,
+                                ThrottleDirection direction)
+{
+    static const BucketType bucket_types[THROTTLE_MAX][4] = {
+        { THROTTLE_BPS_TOTAL, THROTTLE_BPS_READ,
+          THROTTLE_OPS_TOTAL, THROTTLE_OPS_READ },
+        { THROTTLE_BPS_TOTAL, THROTTLE_BPS_WRITE,
+          THROTTLE_OPS_TOTAL, THROTTLE_OPS_WRITE },
+    };
+    int i;
+
+    assert(direction < THROTTLE_MAX);
+    for (i = 0; i < ARRAY_SIZE(bucket_types[direction]); i++) {
+        if (cfg->buckets[bucket_types[direction][i]].avg > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /* check if a throttling configuration is valid
  * @cfg: the throttling configuration to inspect
  * @ret: true if valid else false
@@ -27,7 +27,16 @@
  * protocol messages over the UNIX domain socket.
  *
  * When virtqueues are set up libvhost-user calls set_watch() to monitor kick
- * fds. These fds are also handled in the VuServer->ctx AioContext.
+ * fds. These fds are also handled in the VuServer->ctx AioContext, unless
+ * per-virtqueue AioContexts were given to vhost_user_server_start(). In that
+ * case each kick fd is handled in its virtqueue's AioContext so that several
+ * threads can process requests in parallel. libvhost-user is not thread-safe,
+ * so kick fd monitoring is paused while vu_client_trip() handles a vhost-user
+ * message that changes vring or memory state: vu_message_read() stops
+ * monitoring the kick fds, waits for kick handlers and in-flight requests to
+ * finish and vu_client_trip() resumes monitoring once the message has been
+ * processed. Messages that only query device properties are handled without
+ * pausing, see vu_message_needs_pause().
  *
  * Both vu_client_trip() and kick fd monitoring can be stopped by shutting down
  * the socket connection. Shutting down the socket connection causes
@@ -77,15 +86,18 @@ static void panic_cb(VuDev *vu_dev, const char *buf)
 
 void vhost_user_server_inc_in_flight(VuServer *server)
 {
-    assert(!server->wait_idle);
+    assert(!qatomic_read(&server->idle_co));
     qatomic_inc(&server->in_flight);
 }
 
+/* May be called from any thread when per-virtqueue AioContexts are used */
 void vhost_user_server_dec_in_flight(VuServer *server)
 {
     if (qatomic_fetch_dec(&server->in_flight) == 1) {
-        if (server->wait_idle) {
-            aio_co_wake(server->co_trip);
+        Coroutine *co = qatomic_xchg(&server->idle_co, NULL);
+
+        if (co) {
+            aio_co_wake(co);
         }
     }
 }
@@ -95,6 +107,120 @@ bool vhost_user_server_has_in_flight(VuServer *server)
     return qatomic_load_acquire(&server->in_flight) > 0;
 }
 
+/* Wait until there are no in-flight requests */
+static void coroutine_fn vu_wait_idle(VuServer *server)
+{
+    qatomic_set(&server->idle_co, qemu_coroutine_self());
+    smp_mb(); /* pairs with qatomic_fetch_dec() in dec_in_flight */
+
+    /*
+     * If the counter already dropped to zero, whoever takes idle_co back is
+     * responsible for it: either we do and return, or a concurrent
+     * vhost_user_server_dec_in_flight() does and will wake us.
+     */
+    if (vhost_user_server_has_in_flight(server) ||
+        !qatomic_xchg(&server->idle_co, NULL)) {
+        qemu_coroutine_yield();
+    }
+}
+
+static void kick_handler(void *opaque);
+
+static void vu_fd_watch_detach(VuFdWatch *vu_fd_watch)
+{
+    if (vu_fd_watch->ctx) {
+        aio_set_fd_handler(vu_fd_watch->ctx, vu_fd_watch->fd,
+                           NULL, NULL, NULL, NULL, NULL);
+        vu_fd_watch->ctx = NULL;
+    }
+}
+
+static void vu_fd_watch_attach(VuServer *server, VuFdWatch *vu_fd_watch)
+{
+    AioContext *ctx = vu_fd_watch->vq_ctx ?: server->ctx;
+
+    if (vu_fd_watch->ctx == ctx) {
+        return;
+    }
+
+    vu_fd_watch_detach(vu_fd_watch);
+    aio_set_fd_handler(ctx, vu_fd_watch->fd, kick_handler,
+                       NULL, NULL, NULL, vu_fd_watch);
+    vu_fd_watch->ctx = ctx;
+}
+
+static void vu_co_wake_bh(void *opaque)
+{
+    aio_co_wake(opaque);
+}
+
+/*
+ * Stop processing virtqueues in per-virtqueue AioContexts so that the current
+ * vhost-user message can be handled without racing with other threads.
+ */
+static void coroutine_fn vu_pause_vqs(VuServer *server)
+{
+    VuFdWatch *vu_fd_watch;
+    unsigned int i;
+
+    if (!server->nr_vq_ctxs || server->vqs_paused) {
+        return;
+    }
+
+    server->vqs_paused = true;
+
+    QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
+        vu_fd_watch_detach(vu_fd_watch);
+    }
+
+    /* A kick handler might still be running, wait for it to return */
+    for (i = 0; i < server->nr_vq_ctxs; i++) {
+        aio_bh_schedule_oneshot(server->vq_ctxs[i], vu_co_wake_bh,
+                                qemu_coroutine_self());
+        qemu_coroutine_yield();
+    }
+
+    vu_wait_idle(server);
+}
+
+static void vu_resume_vqs(VuServer *server)
+{
+    VuFdWatch *vu_fd_watch;
+
+    if (!server->vqs_paused) {
+        return;
+    }
+
+    server->vqs_paused = false;
+
+    /* Otherwise vhost_user_server_attach_aio_context() resumes monitoring */
+    if (server->ctx) {
+        QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
+            vu_fd_watch_attach(server, vu_fd_watch);
+        }
+    }
+}
+
+/*
+ * Returns whether handling @vmsg may change or depend on the vring or guest
+ * memory state, so that virtqueue processing in other threads must be paused
+ * first.  Requests that only query device properties can run concurrently.
+ */
+static bool vu_message_needs_pause(const VhostUserMsg *vmsg)
+{
+    switch (vmsg->request) {
+    case VHOST_USER_GET_FEATURES:
+    case VHOST_USER_SET_OWNER:
+    case VHOST_USER_GET_PROTOCOL_FEATURES:
+    case VHOST_USER_GET_QUEUE_NUM:
+    case VHOST_USER_GET_CONFIG:
+    case VHOST_USER_GET_MAX_MEM_SLOTS:
+        return false;
+    default:
+        return true;
+    }
+}
+
 static bool coroutine_fn
 vu_message_read(VuDev *vu_dev, int conn_fd, VhostUserMsg *vmsg)
 {
@@ -187,6 +313,9 @@ vu_message_read(VuDev *vu_dev, int conn_fd, VhostUserMsg *vmsg)
         }
     }
 
+    if (vu_message_needs_pause(vmsg)) {
+        vu_pause_vqs(server);
+    }
     return true;
 
 fail:
@@ -202,6 +331,8 @@ static coroutine_fn void vu_client_trip(void *opaque)
 
     while (!vu_dev->broken) {
         if (server->quiescing) {
+            /* vhost_user_server_detach_aio_context() detached the kick fds */
+            server->vqs_paused = false;
             server->co_trip = NULL;
             aio_wait_kick();
             return;
@@ -210,14 +341,14 @@ static coroutine_fn void vu_client_trip(void *opaque)
         if (!vu_dispatch(vu_dev) && server->ctx) {
             break;
         }
+        vu_resume_vqs(server);
     }
 
-    if (vhost_user_server_has_in_flight(server)) {
-        /* Wait for requests to complete before we can unmap the memory */
-        server->wait_idle = true;
-        qemu_coroutine_yield();
-        server->wait_idle = false;
-    }
+    /* Stop virtqueue processing in other threads */
+    vu_pause_vqs(server);
+
+    /* Wait for requests to complete before we can unmap the memory */
+    vu_wait_idle(server);
     assert(!vhost_user_server_has_in_flight(server));
 
     vu_deinit(vu_dev);
@@ -231,6 +362,7 @@ static coroutine_fn void vu_client_trip(void *opaque)
     object_unref(OBJECT(server->ioc));
     server->ioc = NULL;
 
+    server->vqs_paused = false;
     server->co_trip = NULL;
     if (server->restart_listener_bh) {
         qemu_bh_schedule(server->restart_listener_bh);
@@ -291,11 +423,21 @@ set_watch(VuDev *vu_dev, int fd, int vu_evt,
 
         vu_fd_watch->fd = fd;
         vu_fd_watch->cb = cb;
-        qemu_socket_set_nonblock(fd);
-        aio_set_fd_handler(server->ctx, fd, kick_handler,
-                           NULL, NULL, NULL, vu_fd_watch);
         vu_fd_watch->vu_dev = vu_dev;
         vu_fd_watch->pvt = pvt;
+
+        /* libvhost-user passes the virtqueue index for kick fds */
+        if (server->nr_vq_ctxs) {
+            uintptr_t vq_index = (uintptr_t)pvt;
+
+            vu_fd_watch->vq_ctx =
+                server->vq_ctxs[vq_index % server->nr_vq_ctxs];
+        }
+
+        qemu_socket_set_nonblock(fd);
+        if (!server->vqs_paused) {
+            vu_fd_watch_attach(server, vu_fd_watch);
+        }
     }
 }
 
@@ -313,7 +455,7 @@ static void remove_watch(VuDev *vu_dev, int fd)
     if (!vu_fd_watch) {
         return;
     }
-    aio_set_fd_handler(server->ctx, fd, NULL, NULL, NULL, NULL, NULL);
+    vu_fd_watch_detach(vu_fd_watch);
 
     QTAILQ_REMOVE(&server->vu_fd_watches, vu_fd_watch, next);
     g_free(vu_fd_watch);
@@ -373,8 +515,7 @@ void vhost_user_server_stop(VuServer *server)
         VuFdWatch *vu_fd_watch;
 
         QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-            aio_set_fd_handler(server->ctx, vu_fd_watch->fd,
-                               NULL, NULL, NULL, NULL, vu_fd_watch);
+            vu_fd_watch_detach(vu_fd_watch);
         }
 
         qio_channel_shutdown(server->ioc, QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
@@ -411,9 +552,11 @@ void vhost_user_server_attach_aio_context(VuServer *server, AioContext *ctx)
         return;
     }
 
-    QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-        aio_set_fd_handler(ctx, vu_fd_watch->fd, kick_handler, NULL,
-                           NULL, NULL, vu_fd_watch);
+    /* vu_client_trip() resumes monitoring once the message is processed */
+    if (!server->vqs_paused) {
+        QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
+            vu_fd_watch_attach(server, vu_fd_watch);
+        }
     }
 
     if (server->co_trip) {
@@ -444,8 +587,7 @@ void vhost_user_server_detach_aio_context(VuServer *server)
         VuFdWatch *vu_fd_watch;
 
         QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-            aio_set_fd_handler(server->ctx, vu_fd_watch->fd,
-                               NULL, NULL, NULL, NULL, vu_fd_watch);
+            vu_fd_watch_detach(vu_fd_watch);
         }
     }
 
@@ -463,6 +605,8 @@ bool vhost_user_server_start(VuServer *server,
                              SocketAddress *socket_addr,
                              AioContext *ctx,
                              uint16_t max_queues,
+                             AioContext **vq_ctxs,
+                             unsigned int nr_vq_ctxs,
                              const VuDevIface *vu_iface,
                              Error **errp)
 {
@@ -490,6 +634,8 @@ bool vhost_user_server_start(VuServer *server,
         .restart_listener_bh   = bh,
         .vu_iface              = vu_iface,
         .max_queues            = max_queues,
+        .vq_ctxs               = vq_ctxs,
+        .nr_vq_ctxs            = nr_vq_ctxs,
         .ctx                   = ctx,
     };
 